@@ -6,257 +6,934 @@
 #include <optional>
 #include <iostream>
 #include <set>
-#include <map>
-#include <codecvt>
-#include <sstream>
-
+#include <unordered_map>
+#include <unordered_set>
+#include <span>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <numeric>
+#include <algorithm>
+#include <utility>
+#include <bit>
+#include <memory>
+#include <iomanip>
+#include <charconv>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Keeps a single copy of every namespace, key and source path and hands out compact ids for them. Strings are spread
+// over shards by hash, each shard with its own lock, so extraction threads rarely wait for each other.
+class string_pool
+{
+public:
+	uint32_t intern(std::u16string_view s)
+	{
+		const auto shard_index = std::hash<std::u16string_view>{}(s) % SHARD_COUNT;
+		auto & shard = shards[shard_index];
+		const auto lock = std::lock_guard{ shard.mutex };
+		if (const auto it = shard.ids.find(s); it != shard.ids.end())
+			return it->second;
+		const auto id = static_cast<uint32_t>(shard.strings.size() * SHARD_COUNT + shard_index);
+		shard.ids.emplace(shard.strings.emplace_back(s), id);
+		return id;
+	}
 
-#include <unicode/uchar.h>
+	std::u16string_view view(uint32_t id) const
+	{
+		auto const& shard = shards[id % SHARD_COUNT];
+		const auto lock = std::lock_guard{ shard.mutex };
+		return shard.strings[id / SHARD_COUNT];
+	}
 
-struct FText
-{
-	std::wstring ns;
-	std::wstring key;
-	std::wstring s;
+	std::u16string_view store(std::u16string_view s)
+	{
+		return view(intern(s));
+	}
+
+private:
+	static constexpr size_t SHARD_COUNT = 16;
+
+	struct shard
+	{
+		mutable std::mutex mutex;
+		std::deque<std::u16string> strings; // never moves its elements, the views stay valid
+		std::unordered_map<std::u16string_view, uint32_t> ids;
+	};
 
-	std::wstring src;
+	std::array<shard, SHARD_COUNT> shards;
 };
 
-inline bool test_signature(std::string_view const& signature, std::vector<char> const& buffer, size_t index)
+// A localization key. Keys of exactly 32 uppercase hex digits, the usual GUID keys, are kept as 16 binary bytes, all
+// others as a string_pool id. The text of a GUID key is only rebuilt for output.
+class text_key
 {
-	return std::string_view(buffer.data() + index, buffer.size() - index).starts_with(signature);
-}
+public:
+	text_key() = default;
 
-bool good_ch(wchar_t ch)
-{
-	if (U_MASK(u_charType(ch)) & (~U_GC_C_MASK | U_GC_CF_MASK | U_GC_CS_MASK)) // all categories but controls + format controls and surrogate controls
-		return true;
-	if (0x09 <= ch && ch <= 0x0d || 0x1c <= ch && ch <= 0x1f) // some ISO format controls
-		return true;
-	return false;
-}
+	static text_key from_string(std::u16string_view key, string_pool & pool)
+	{
+		if (const auto guid = parse_guid(key.size(), [&] (size_t i) { return key[i]; }); guid.has_value())
+			return guid.value();
+		return text_key{ 0, pool.intern(key), false };
+	}
 
-bool very_good_key(std::wstring const& key)
-{
-	if (key.size() != 32)
-		return false;
-	for (const auto c : key)
-		if (!(L'0' <= c && c <= L'9' || L'A' <= c && c <= L'F'))
-			return false;
-	return true;
-}
+	// at(i) returns the i-th of the size characters of the key.
+	template <typename At>
+	static std::optional<text_key> parse_guid(size_t size, At const& at)
+	{
+		if (size != 32)
+			return std::nullopt;
+		uint64_t parts[2] = { 0, 0 };
+		for (size_t i = 0; i < 32; ++i)
+		{
+			const char16_t c = at(i);
+			uint64_t digit = 0;
+			if (u'0' <= c && c <= u'9')
+				digit = c - u'0';
+			else if (u'A' <= c && c <= u'F')
+				digit = c - u'A' + 10;
+			else
+				return std::nullopt;
+			parts[i / 16] = parts[i / 16] << 4 | digit;
+		}
+		return text_key{ parts[0], parts[1], true };
+	}
+
+	static text_key from_id(uint32_t id)
+	{
+		return text_key{ 0, id, false };
+	}
+
+	std::u16string to_string(string_pool const& pool) const
+	{
+		if (!guid)
+			return std::u16string{ pool.view(static_cast<uint32_t>(low)) };
+		constexpr std::u16string_view DIGITS = u"0123456789ABCDEF";
+		auto key = std::u16string(32, u'0');
+		for (size_t i = 0; i < 16; ++i)
+		{
+			key[i] = DIGITS[high >> (60 - 4 * i) & 0xF];
+			key[16 + i] = DIGITS[low >> (60 - 4 * i) & 0xF];
+		}
+		return key;
+	}
+
+	size_t hash() const
+	{
+		return std::hash<uint64_t>{}(high ^ low * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(guid));
+	}
+
+	bool operator==(text_key const&) const = default;
+
+private:
+	text_key(uint64_t high, uint64_t low, bool guid)
+		: high(high), low(low), guid(guid)
+	{
+	}
+
+	uint64_t high = 0;
+	uint64_t low = 0; // string_pool id for other keys
+	bool guid = false;
+};
 
-bool all_white_spaces(std::wstring const& s)
+template <>
+struct std::hash<text_key>
 {
-	for (const auto c : s)
-		if (!u_isspace(c))
-			return false;
-	return true;
-}
+	size_t operator()(text_key const& key) const
+	{
+		return key.hash();
+	}
+};
 
-bool has_letter(std::wstring const& s)
+// Monotonic storage for text payloads. Strings are appended into large blocks which are only released all together
+// with the arena. Every worker fills its own arena, so no locking is needed.
+class text_arena
 {
-	for (const auto c : s)
-		if (u_isalpha(c))
-			return true;
-	return false;
-}
+public:
+	char16_t * allocate(size_t count)
+	{
+		if (available < count)
+		{
+			if (BLOCK_SIZE / 4 < count)
+			{
+				blocks.push_back(std::make_unique_for_overwrite<char16_t[]>(count)); // too large to share a block
+				return blocks.back().get();
+			}
+			blocks.push_back(std::make_unique_for_overwrite<char16_t[]>(BLOCK_SIZE));
+			current = blocks.back().get();
+			available = BLOCK_SIZE;
+		}
+		const auto result = current;
+		current += count;
+		available -= count;
+		return result;
+	}
+
+	std::u16string_view store(std::u16string_view s)
+	{
+		const auto data = allocate(s.size());
+		std::copy(s.begin(), s.end(), data);
+		return { data, s.size() };
+	}
 
-std::optional<std::pair<FText, size_t>> try_read_blueprint_text(std::vector<char> const& buffer, size_t index)
+	// Takes over the blocks of other, the strings in them stay where they are.
+	void splice(text_arena && other)
+	{
+		std::move(other.blocks.begin(), other.blocks.end(), std::back_inserter(blocks));
+		other.blocks.clear();
+		other.current = nullptr;
+		other.available = 0;
+	}
+
+private:
+	static constexpr size_t BLOCK_SIZE = 256 * 1024; // characters
+
+	std::vector<std::unique_ptr<char16_t[]>> blocks;
+	char16_t * current = nullptr;
+	size_t available = 0;
+};
+
+struct FText
 {
-	constexpr std::string_view BLUEPRINT_TEXT_SIGNATURE = "\x29\x01"; // EX_TextConst, EBlueprintTextLiteralType::LocalizedText
+	uint32_t ns; // string_pool ids
+	text_key key;
+	std::u16string_view s; // stored in a text_arena
 
-	if (!test_signature(BLUEPRINT_TEXT_SIGNATURE, buffer, index))
-		return std::nullopt;
+	uint32_t src;
+};
 
-	index += BLUEPRINT_TEXT_SIGNATURE.size();
+using byte_span = std::span<const std::byte>;
 
-	const auto read_to_null = [&] () -> std::optional<std::wstring> {
-		if (buffer.size() <= index)
-			return std::nullopt;
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	mapped_file(mapped_file const&) = delete;
+	mapped_file & operator=(mapped_file const&) = delete;
+	~mapped_file()
+	{
+		close();
+	}
+
+	bool open(std::filesystem::path const& file)
+	{
+		close();
 
-		if (buffer[index] == 0x1F) // ANSI (EX_StringConst)
+#ifdef _WIN32
+		file_handle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_handle != INVALID_HANDLE_VALUE)
 		{
-			std::wstring s;
-			for (++index; index < buffer.size(); ++index)
+			LARGE_INTEGER size;
+			if (GetFileSizeEx(file_handle, &size) && 0 < size.QuadPart) // empty files can't be mapped
 			{
-				const auto ch = buffer[index];
-				if (ch == 0)
+				mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping_handle != nullptr)
+					view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+				if (view != nullptr)
 				{
-					++index;
-					return s;
+					data = byte_span(static_cast<const std::byte*>(view), static_cast<size_t>(size.QuadPart));
+					return true;
 				}
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
 			}
-			return std::nullopt;
+			close();
 		}
-
-		if (buffer[index] == 0x34) // UTF-16 (EX_UnicodeStringConst)
+#else
+		file_descriptor = ::open(file.c_str(), O_RDONLY);
+		if (file_descriptor != -1)
 		{
-			std::wstring s;
-			for (++index; index < buffer.size(); index += 2)
+			struct stat status;
+			if (fstat(file_descriptor, &status) == 0 && 0 < status.st_size) // empty files can't be mapped
 			{
-				if (buffer.size() <= index + 1)
-					return std::nullopt;
-				const auto ch = *reinterpret_cast<const wchar_t*>(buffer.data() + index);
-				if (ch == 0)
+				view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+				if (view != MAP_FAILED)
 				{
-					index += 2;
-					return s;
+					view_size = static_cast<size_t>(status.st_size);
+					madvise(view, view_size, MADV_SEQUENTIAL);
+					data = byte_span(static_cast<const std::byte*>(view), view_size);
+					return true;
 				}
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
+				view = nullptr;
 			}
-			return std::nullopt;
+			close();
 		}
+#endif
 
-		return std::nullopt;
-	};
+		// fallback to plain buffered read
+		auto fin = std::ifstream{ file, std::ios::binary | std::ios::ate };
+		if (fin.fail())
+			return false;
+		fallback = std::vector<std::byte>(fin.tellg());
+		fin.seekg(0, std::ios::beg);
+		fin.read(reinterpret_cast<char*>(fallback.data()), fallback.size());
+		data = fallback;
+		return true;
+	}
 
-	const auto s = read_to_null();
-	if (!s.has_value())
-		return std::nullopt;
-	if (s->size() == 0)
-		return std::nullopt;
-	const auto key = read_to_null();
-	if (!key.has_value())
-		return std::nullopt;
-	if (key->size() == 0)
-		return std::nullopt;
-	if (128 < key->size())   // static const int32 InlineStringSize = 128;
-		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
-	if (all_white_spaces(s.value()))
-		return std::nullopt;
-	const auto ns = read_to_null();
-	if (!ns.has_value())
-		return std::nullopt;
-	if (128 < ns->size())    // static const int32 InlineStringSize = 128;
-		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
-	int good_score = 0;
-	if (very_good_key(key.value()))
-		good_score += 10;
-	if (has_letter(s.value()))
-		good_score += 5;
-	if (good_score < 5)
-		return std::nullopt;
+	void close()
+	{
+#ifdef _WIN32
+		if (view != nullptr)
+			UnmapViewOfFile(view);
+		if (mapping_handle != nullptr)
+			CloseHandle(mapping_handle);
+		if (file_handle != INVALID_HANDLE_VALUE)
+			CloseHandle(file_handle);
+		view = nullptr;
+		mapping_handle = nullptr;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (view != nullptr)
+			munmap(view, view_size);
+		if (file_descriptor != -1)
+			::close(file_descriptor);
+		view = nullptr;
+		view_size = 0;
+		file_descriptor = -1;
+#endif
+		fallback = {};
+		data = {};
+	}
+
+	byte_span bytes() const
+	{
+		return data;
+	}
 
-	return std::pair{ FText{ ns.value(), key.value(), s.value() }, index };
+private:
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+	HANDLE mapping_handle = nullptr;
+	LPVOID view = nullptr;
+#else
+	int file_descriptor = -1;
+	void * view = nullptr;
+	size_t view_size = 0;
+#endif
+	std::vector<std::byte> fallback;
+	byte_span data;
+};
+
+template <typename T>
+inline T read_as(byte_span buffer, size_t index)
+{
+	T value;
+	std::memcpy(&value, buffer.data() + index, sizeof(T)); // mapped data has no alignment guarantees
+	return value;
 }
 
-std::optional<std::pair<FText, size_t>> try_read_ftext(std::vector<char> const& buffer, size_t index)
+// One code unit of an ANSI (char) or UTF-16 (char16_t) string. ANSI bytes are Latin-1, they are widened as unsigned
+// whatever the signedness of char on the platform.
+template <typename Char>
+inline char16_t read_code_unit(byte_span buffer, size_t index)
 {
-	if (buffer.size() < index + 5)
-		return std::nullopt;
+	if constexpr (sizeof(Char) == 1)
+		return std::to_integer<uint8_t>(buffer[index]);
+	else
+		return read_as<char16_t>(buffer, index);
+}
 
-	const auto flag = *reinterpret_cast<const int*>(buffer.data() + index);
-	index += 4;
+inline bool test_signature(std::string_view const& signature, byte_span buffer, size_t index)
+{
+	return std::string_view(reinterpret_cast<const char*>(buffer.data()) + index, buffer.size() - index).starts_with(signature);
+}
 
-	if (0b00011111 < flag) // highest flag right now: InitializedFromString = (1<<4)
-		return std::nullopt;
+struct code_point_range
+{
+	uint16_t first;
+	uint16_t last;
+};
 
-	if (flag & 0b00000100) // ConvertedProperty = (1 << 2) never set in cooked text
-		return std::nullopt;
+// BMP code points of the character classes below for Unicode 13.0 (the bundled ICU 69), generated and checked with
+// tools/gen_bmp_tables.cpp.
+// good_ch: all categories but controls, private use and unassigned (format controls and surrogates are fine),
+// plus the ISO format controls 0x09-0x0d and 0x1c-0x1f.
+constexpr code_point_range GOOD_CHAR_RANGES[] = {
+	{ 0x0009, 0x000D }, { 0x001C, 0x007E }, { 0x00A0, 0x0377 }, { 0x037A, 0x037F }, { 0x0384, 0x038A }, { 0x038C, 0x038C }, { 0x038E, 0x03A1 }, { 0x03A3, 0x052F },
+	{ 0x0531, 0x0556 }, { 0x0559, 0x058A }, { 0x058D, 0x058F }, { 0x0591, 0x05C7 }, { 0x05D0, 0x05EA }, { 0x05EF, 0x05F4 }, { 0x0600, 0x061C }, { 0x061E, 0x070D },
+	{ 0x070F, 0x074A }, { 0x074D, 0x07B1 }, { 0x07C0, 0x07FA }, { 0x07FD, 0x082D }, { 0x0830, 0x083E }, { 0x0840, 0x085B }, { 0x085E, 0x085E }, { 0x0860, 0x086A },
+	{ 0x08A0, 0x08B4 }, { 0x08B6, 0x08C7 }, { 0x08D3, 0x0983 }, { 0x0985, 0x098C }, { 0x098F, 0x0990 }, { 0x0993, 0x09A8 }, { 0x09AA, 0x09B0 }, { 0x09B2, 0x09B2 },
+	{ 0x09B6, 0x09B9 }, { 0x09BC, 0x09C4 }, { 0x09C7, 0x09C8 }, { 0x09CB, 0x09CE }, { 0x09D7, 0x09D7 }, { 0x09DC, 0x09DD }, { 0x09DF, 0x09E3 }, { 0x09E6, 0x09FE },
+	{ 0x0A01, 0x0A03 }, { 0x0A05, 0x0A0A }, { 0x0A0F, 0x0A10 }, { 0x0A13, 0x0A28 }, { 0x0A2A, 0x0A30 }, { 0x0A32, 0x0A33 }, { 0x0A35, 0x0A36 }, { 0x0A38, 0x0A39 },
+	{ 0x0A3C, 0x0A3C }, { 0x0A3E, 0x0A42 }, { 0x0A47, 0x0A48 }, { 0x0A4B, 0x0A4D }, { 0x0A51, 0x0A51 }, { 0x0A59, 0x0A5C }, { 0x0A5E, 0x0A5E }, { 0x0A66, 0x0A76 },
+	{ 0x0A81, 0x0A83 }, { 0x0A85, 0x0A8D }, { 0x0A8F, 0x0A91 }, { 0x0A93, 0x0AA8 }, { 0x0AAA, 0x0AB0 }, { 0x0AB2, 0x0AB3 }, { 0x0AB5, 0x0AB9 }, { 0x0ABC, 0x0AC5 },
+	{ 0x0AC7, 0x0AC9 }, { 0x0ACB, 0x0ACD }, { 0x0AD0, 0x0AD0 }, { 0x0AE0, 0x0AE3 }, { 0x0AE6, 0x0AF1 }, { 0x0AF9, 0x0AFF }, { 0x0B01, 0x0B03 }, { 0x0B05, 0x0B0C },
+	{ 0x0B0F, 0x0B10 }, { 0x0B13, 0x0B28 }, { 0x0B2A, 0x0B30 }, { 0x0B32, 0x0B33 }, { 0x0B35, 0x0B39 }, { 0x0B3C, 0x0B44 }, { 0x0B47, 0x0B48 }, { 0x0B4B, 0x0B4D },
+	{ 0x0B55, 0x0B57 }, { 0x0B5C, 0x0B5D }, { 0x0B5F, 0x0B63 }, { 0x0B66, 0x0B77 }, { 0x0B82, 0x0B83 }, { 0x0B85, 0x0B8A }, { 0x0B8E, 0x0B90 }, { 0x0B92, 0x0B95 },
+	{ 0x0B99, 0x0B9A }, { 0x0B9C, 0x0B9C }, { 0x0B9E, 0x0B9F }, { 0x0BA3, 0x0BA4 }, { 0x0BA8, 0x0BAA }, { 0x0BAE, 0x0BB9 }, { 0x0BBE, 0x0BC2 }, { 0x0BC6, 0x0BC8 },
+	{ 0x0BCA, 0x0BCD }, { 0x0BD0, 0x0BD0 }, { 0x0BD7, 0x0BD7 }, { 0x0BE6, 0x0BFA }, { 0x0C00, 0x0C0C }, { 0x0C0E, 0x0C10 }, { 0x0C12, 0x0C28 }, { 0x0C2A, 0x0C39 },
+	{ 0x0C3D, 0x0C44 }, { 0x0C46, 0x0C48 }, { 0x0C4A, 0x0C4D }, { 0x0C55, 0x0C56 }, { 0x0C58, 0x0C5A }, { 0x0C60, 0x0C63 }, { 0x0C66, 0x0C6F }, { 0x0C77, 0x0C8C },
+	{ 0x0C8E, 0x0C90 }, { 0x0C92, 0x0CA8 }, { 0x0CAA, 0x0CB3 }, { 0x0CB5, 0x0CB9 }, { 0x0CBC, 0x0CC4 }, { 0x0CC6, 0x0CC8 }, { 0x0CCA, 0x0CCD }, { 0x0CD5, 0x0CD6 },
+	{ 0x0CDE, 0x0CDE }, { 0x0CE0, 0x0CE3 }, { 0x0CE6, 0x0CEF }, { 0x0CF1, 0x0CF2 }, { 0x0D00, 0x0D0C }, { 0x0D0E, 0x0D10 }, { 0x0D12, 0x0D44 }, { 0x0D46, 0x0D48 },
+	{ 0x0D4A, 0x0D4F }, { 0x0D54, 0x0D63 }, { 0x0D66, 0x0D7F }, { 0x0D81, 0x0D83 }, { 0x0D85, 0x0D96 }, { 0x0D9A, 0x0DB1 }, { 0x0DB3, 0x0DBB }, { 0x0DBD, 0x0DBD },
+	{ 0x0DC0, 0x0DC6 }, { 0x0DCA, 0x0DCA }, { 0x0DCF, 0x0DD4 }, { 0x0DD6, 0x0DD6 }, { 0x0DD8, 0x0DDF }, { 0x0DE6, 0x0DEF }, { 0x0DF2, 0x0DF4 }, { 0x0E01, 0x0E3A },
+	{ 0x0E3F, 0x0E5B }, { 0x0E81, 0x0E82 }, { 0x0E84, 0x0E84 }, { 0x0E86, 0x0E8A }, { 0x0E8C, 0x0EA3 }, { 0x0EA5, 0x0EA5 }, { 0x0EA7, 0x0EBD }, { 0x0EC0, 0x0EC4 },
+	{ 0x0EC6, 0x0EC6 }, { 0x0EC8, 0x0ECD }, { 0x0ED0, 0x0ED9 }, { 0x0EDC, 0x0EDF }, { 0x0F00, 0x0F47 }, { 0x0F49, 0x0F6C }, { 0x0F71, 0x0F97 }, { 0x0F99, 0x0FBC },
+	{ 0x0FBE, 0x0FCC }, { 0x0FCE, 0x0FDA }, { 0x1000, 0x10C5 }, { 0x10C7, 0x10C7 }, { 0x10CD, 0x10CD }, { 0x10D0, 0x1248 }, { 0x124A, 0x124D }, { 0x1250, 0x1256 },
+	{ 0x1258, 0x1258 }, { 0x125A, 0x125D }, { 0x1260, 0x1288 }, { 0x128A, 0x128D }, { 0x1290, 0x12B0 }, { 0x12B2, 0x12B5 }, { 0x12B8, 0x12BE }, { 0x12C0, 0x12C0 },
+	{ 0x12C2, 0x12C5 }, { 0x12C8, 0x12D6 }, { 0x12D8, 0x1310 }, { 0x1312, 0x1315 }, { 0x1318, 0x135A }, { 0x135D, 0x137C }, { 0x1380, 0x1399 }, { 0x13A0, 0x13F5 },
+	{ 0x13F8, 0x13FD }, { 0x1400, 0x169C }, { 0x16A0, 0x16F8 }, { 0x1700, 0x170C }, { 0x170E, 0x1714 }, { 0x1720, 0x1736 }, { 0x1740, 0x1753 }, { 0x1760, 0x176C },
+	{ 0x176E, 0x1770 }, { 0x1772, 0x1773 }, { 0x1780, 0x17DD }, { 0x17E0, 0x17E9 }, { 0x17F0, 0x17F9 }, { 0x1800, 0x180E }, { 0x1810, 0x1819 }, { 0x1820, 0x1878 },
+	{ 0x1880, 0x18AA }, { 0x18B0, 0x18F5 }, { 0x1900, 0x191E }, { 0x1920, 0x192B }, { 0x1930, 0x193B }, { 0x1940, 0x1940 }, { 0x1944, 0x196D }, { 0x1970, 0x1974 },
+	{ 0x1980, 0x19AB }, { 0x19B0, 0x19C9 }, { 0x19D0, 0x19DA }, { 0x19DE, 0x1A1B }, { 0x1A1E, 0x1A5E }, { 0x1A60, 0x1A7C }, { 0x1A7F, 0x1A89 }, { 0x1A90, 0x1A99 },
+	{ 0x1AA0, 0x1AAD }, { 0x1AB0, 0x1AC0 }, { 0x1B00, 0x1B4B }, { 0x1B50, 0x1B7C }, { 0x1B80, 0x1BF3 }, { 0x1BFC, 0x1C37 }, { 0x1C3B, 0x1C49 }, { 0x1C4D, 0x1C88 },
+	{ 0x1C90, 0x1CBA }, { 0x1CBD, 0x1CC7 }, { 0x1CD0, 0x1CFA }, { 0x1D00, 0x1DF9 }, { 0x1DFB, 0x1F15 }, { 0x1F18, 0x1F1D }, { 0x1F20, 0x1F45 }, { 0x1F48, 0x1F4D },
+	{ 0x1F50, 0x1F57 }, { 0x1F59, 0x1F59 }, { 0x1F5B, 0x1F5B }, { 0x1F5D, 0x1F5D }, { 0x1F5F, 0x1F7D }, { 0x1F80, 0x1FB4 }, { 0x1FB6, 0x1FC4 }, { 0x1FC6, 0x1FD3 },
+	{ 0x1FD6, 0x1FDB }, { 0x1FDD, 0x1FEF }, { 0x1FF2, 0x1FF4 }, { 0x1FF6, 0x1FFE }, { 0x2000, 0x2064 }, { 0x2066, 0x2071 }, { 0x2074, 0x208E }, { 0x2090, 0x209C },
+	{ 0x20A0, 0x20BF }, { 0x20D0, 0x20F0 }, { 0x2100, 0x218B }, { 0x2190, 0x2426 }, { 0x2440, 0x244A }, { 0x2460, 0x2B73 }, { 0x2B76, 0x2B95 }, { 0x2B97, 0x2C2E },
+	{ 0x2C30, 0x2C5E }, { 0x2C60, 0x2CF3 }, { 0x2CF9, 0x2D25 }, { 0x2D27, 0x2D27 }, { 0x2D2D, 0x2D2D }, { 0x2D30, 0x2D67 }, { 0x2D6F, 0x2D70 }, { 0x2D7F, 0x2D96 },
+	{ 0x2DA0, 0x2DA6 }, { 0x2DA8, 0x2DAE }, { 0x2DB0, 0x2DB6 }, { 0x2DB8, 0x2DBE }, { 0x2DC0, 0x2DC6 }, { 0x2DC8, 0x2DCE }, { 0x2DD0, 0x2DD6 }, { 0x2DD8, 0x2DDE },
+	{ 0x2DE0, 0x2E52 }, { 0x2E80, 0x2E99 }, { 0x2E9B, 0x2EF3 }, { 0x2F00, 0x2FD5 }, { 0x2FF0, 0x2FFB }, { 0x3000, 0x303F }, { 0x3041, 0x3096 }, { 0x3099, 0x30FF },
+	{ 0x3105, 0x312F }, { 0x3131, 0x318E }, { 0x3190, 0x31E3 }, { 0x31F0, 0x321E }, { 0x3220, 0x9FFC }, { 0xA000, 0xA48C }, { 0xA490, 0xA4C6 }, { 0xA4D0, 0xA62B },
+	{ 0xA640, 0xA6F7 }, { 0xA700, 0xA7BF }, { 0xA7C2, 0xA7CA }, { 0xA7F5, 0xA82C }, { 0xA830, 0xA839 }, { 0xA840, 0xA877 }, { 0xA880, 0xA8C5 }, { 0xA8CE, 0xA8D9 },
+	{ 0xA8E0, 0xA953 }, { 0xA95F, 0xA97C }, { 0xA980, 0xA9CD }, { 0xA9CF, 0xA9D9 }, { 0xA9DE, 0xA9FE }, { 0xAA00, 0xAA36 }, { 0xAA40, 0xAA4D }, { 0xAA50, 0xAA59 },
+	{ 0xAA5C, 0xAAC2 }, { 0xAADB, 0xAAF6 }, { 0xAB01, 0xAB06 }, { 0xAB09, 0xAB0E }, { 0xAB11, 0xAB16 }, { 0xAB20, 0xAB26 }, { 0xAB28, 0xAB2E }, { 0xAB30, 0xAB6B },
+	{ 0xAB70, 0xABED }, { 0xABF0, 0xABF9 }, { 0xAC00, 0xD7A3 }, { 0xD7B0, 0xD7C6 }, { 0xD7CB, 0xD7FB }, { 0xD800, 0xDFFF }, { 0xF900, 0xFA6D }, { 0xFA70, 0xFAD9 },
+	{ 0xFB00, 0xFB06 }, { 0xFB13, 0xFB17 }, { 0xFB1D, 0xFB36 }, { 0xFB38, 0xFB3C }, { 0xFB3E, 0xFB3E }, { 0xFB40, 0xFB41 }, { 0xFB43, 0xFB44 }, { 0xFB46, 0xFBC1 },
+	{ 0xFBD3, 0xFD3F }, { 0xFD50, 0xFD8F }, { 0xFD92, 0xFDC7 }, { 0xFDF0, 0xFDFD }, { 0xFE00, 0xFE19 }, { 0xFE20, 0xFE52 }, { 0xFE54, 0xFE66 }, { 0xFE68, 0xFE6B },
+	{ 0xFE70, 0xFE74 }, { 0xFE76, 0xFEFC }, { 0xFEFF, 0xFEFF }, { 0xFF01, 0xFFBE }, { 0xFFC2, 0xFFC7 }, { 0xFFCA, 0xFFCF }, { 0xFFD2, 0xFFD7 }, { 0xFFDA, 0xFFDC },
+	{ 0xFFE0, 0xFFE6 }, { 0xFFE8, 0xFFEE }, { 0xFFF9, 0xFFFD },
+};
 
-	if (flag & 0b00010000) // InitializedFromString = (1 << 4) never set in cooked text
-		return std::nullopt;
+// u_isspace
+constexpr code_point_range WHITE_SPACE_RANGES[] = {
+	{ 0x0009, 0x000D }, { 0x001C, 0x0020 }, { 0x0085, 0x0085 }, { 0x00A0, 0x00A0 }, { 0x1680, 0x1680 }, { 0x2000, 0x200A }, { 0x2028, 0x2029 }, { 0x202F, 0x202F },
+	{ 0x205F, 0x205F }, { 0x3000, 0x3000 },
+};
 
-	// Strange, but some probably localizable text using this flag
-	//if (flag & 0b00000010) // ShouldGatherForLocalization: no CultureInvariant
-	//	return std::nullopt;
+// u_isalpha
+constexpr code_point_range LETTER_RANGES[] = {
+	{ 0x0041, 0x005A }, { 0x0061, 0x007A }, { 0x00AA, 0x00AA }, { 0x00B5, 0x00B5 }, { 0x00BA, 0x00BA }, { 0x00C0, 0x00D6 }, { 0x00D8, 0x00F6 }, { 0x00F8, 0x02C1 },
+	{ 0x02C6, 0x02D1 }, { 0x02E0, 0x02E4 }, { 0x02EC, 0x02EC }, { 0x02EE, 0x02EE }, { 0x0370, 0x0374 }, { 0x0376, 0x0377 }, { 0x037A, 0x037D }, { 0x037F, 0x037F },
+	{ 0x0386, 0x0386 }, { 0x0388, 0x038A }, { 0x038C, 0x038C }, { 0x038E, 0x03A1 }, { 0x03A3, 0x03F5 }, { 0x03F7, 0x0481 }, { 0x048A, 0x052F }, { 0x0531, 0x0556 },
+	{ 0x0559, 0x0559 }, { 0x0560, 0x0588 }, { 0x05D0, 0x05EA }, { 0x05EF, 0x05F2 }, { 0x0620, 0x064A }, { 0x066E, 0x066F }, { 0x0671, 0x06D3 }, { 0x06D5, 0x06D5 },
+	{ 0x06E5, 0x06E6 }, { 0x06EE, 0x06EF }, { 0x06FA, 0x06FC }, { 0x06FF, 0x06FF }, { 0x0710, 0x0710 }, { 0x0712, 0x072F }, { 0x074D, 0x07A5 }, { 0x07B1, 0x07B1 },
+	{ 0x07CA, 0x07EA }, { 0x07F4, 0x07F5 }, { 0x07FA, 0x07FA }, { 0x0800, 0x0815 }, { 0x081A, 0x081A }, { 0x0824, 0x0824 }, { 0x0828, 0x0828 }, { 0x0840, 0x0858 },
+	{ 0x0860, 0x086A }, { 0x08A0, 0x08B4 }, { 0x08B6, 0x08C7 }, { 0x0904, 0x0939 }, { 0x093D, 0x093D }, { 0x0950, 0x0950 }, { 0x0958, 0x0961 }, { 0x0971, 0x0980 },
+	{ 0x0985, 0x098C }, { 0x098F, 0x0990 }, { 0x0993, 0x09A8 }, { 0x09AA, 0x09B0 }, { 0x09B2, 0x09B2 }, { 0x09B6, 0x09B9 }, { 0x09BD, 0x09BD }, { 0x09CE, 0x09CE },
+	{ 0x09DC, 0x09DD }, { 0x09DF, 0x09E1 }, { 0x09F0, 0x09F1 }, { 0x09FC, 0x09FC }, { 0x0A05, 0x0A0A }, { 0x0A0F, 0x0A10 }, { 0x0A13, 0x0A28 }, { 0x0A2A, 0x0A30 },
+	{ 0x0A32, 0x0A33 }, { 0x0A35, 0x0A36 }, { 0x0A38, 0x0A39 }, { 0x0A59, 0x0A5C }, { 0x0A5E, 0x0A5E }, { 0x0A72, 0x0A74 }, { 0x0A85, 0x0A8D }, { 0x0A8F, 0x0A91 },
+	{ 0x0A93, 0x0AA8 }, { 0x0AAA, 0x0AB0 }, { 0x0AB2, 0x0AB3 }, { 0x0AB5, 0x0AB9 }, { 0x0ABD, 0x0ABD }, { 0x0AD0, 0x0AD0 }, { 0x0AE0, 0x0AE1 }, { 0x0AF9, 0x0AF9 },
+	{ 0x0B05, 0x0B0C }, { 0x0B0F, 0x0B10 }, { 0x0B13, 0x0B28 }, { 0x0B2A, 0x0B30 }, { 0x0B32, 0x0B33 }, { 0x0B35, 0x0B39 }, { 0x0B3D, 0x0B3D }, { 0x0B5C, 0x0B5D },
+	{ 0x0B5F, 0x0B61 }, { 0x0B71, 0x0B71 }, { 0x0B83, 0x0B83 }, { 0x0B85, 0x0B8A }, { 0x0B8E, 0x0B90 }, { 0x0B92, 0x0B95 }, { 0x0B99, 0x0B9A }, { 0x0B9C, 0x0B9C },
+	{ 0x0B9E, 0x0B9F }, { 0x0BA3, 0x0BA4 }, { 0x0BA8, 0x0BAA }, { 0x0BAE, 0x0BB9 }, { 0x0BD0, 0x0BD0 }, { 0x0C05, 0x0C0C }, { 0x0C0E, 0x0C10 }, { 0x0C12, 0x0C28 },
+	{ 0x0C2A, 0x0C39 }, { 0x0C3D, 0x0C3D }, { 0x0C58, 0x0C5A }, { 0x0C60, 0x0C61 }, { 0x0C80, 0x0C80 }, { 0x0C85, 0x0C8C }, { 0x0C8E, 0x0C90 }, { 0x0C92, 0x0CA8 },
+	{ 0x0CAA, 0x0CB3 }, { 0x0CB5, 0x0CB9 }, { 0x0CBD, 0x0CBD }, { 0x0CDE, 0x0CDE }, { 0x0CE0, 0x0CE1 }, { 0x0CF1, 0x0CF2 }, { 0x0D04, 0x0D0C }, { 0x0D0E, 0x0D10 },
+	{ 0x0D12, 0x0D3A }, { 0x0D3D, 0x0D3D }, { 0x0D4E, 0x0D4E }, { 0x0D54, 0x0D56 }, { 0x0D5F, 0x0D61 }, { 0x0D7A, 0x0D7F }, { 0x0D85, 0x0D96 }, { 0x0D9A, 0x0DB1 },
+	{ 0x0DB3, 0x0DBB }, { 0x0DBD, 0x0DBD }, { 0x0DC0, 0x0DC6 }, { 0x0E01, 0x0E30 }, { 0x0E32, 0x0E33 }, { 0x0E40, 0x0E46 }, { 0x0E81, 0x0E82 }, { 0x0E84, 0x0E84 },
+	{ 0x0E86, 0x0E8A }, { 0x0E8C, 0x0EA3 }, { 0x0EA5, 0x0EA5 }, { 0x0EA7, 0x0EB0 }, { 0x0EB2, 0x0EB3 }, { 0x0EBD, 0x0EBD }, { 0x0EC0, 0x0EC4 }, { 0x0EC6, 0x0EC6 },
+	{ 0x0EDC, 0x0EDF }, { 0x0F00, 0x0F00 }, { 0x0F40, 0x0F47 }, { 0x0F49, 0x0F6C }, { 0x0F88, 0x0F8C }, { 0x1000, 0x102A }, { 0x103F, 0x103F }, { 0x1050, 0x1055 },
+	{ 0x105A, 0x105D }, { 0x1061, 0x1061 }, { 0x1065, 0x1066 }, { 0x106E, 0x1070 }, { 0x1075, 0x1081 }, { 0x108E, 0x108E }, { 0x10A0, 0x10C5 }, { 0x10C7, 0x10C7 },
+	{ 0x10CD, 0x10CD }, { 0x10D0, 0x10FA }, { 0x10FC, 0x1248 }, { 0x124A, 0x124D }, { 0x1250, 0x1256 }, { 0x1258, 0x1258 }, { 0x125A, 0x125D }, { 0x1260, 0x1288 },
+	{ 0x128A, 0x128D }, { 0x1290, 0x12B0 }, { 0x12B2, 0x12B5 }, { 0x12B8, 0x12BE }, { 0x12C0, 0x12C0 }, { 0x12C2, 0x12C5 }, { 0x12C8, 0x12D6 }, { 0x12D8, 0x1310 },
+	{ 0x1312, 0x1315 }, { 0x1318, 0x135A }, { 0x1380, 0x138F }, { 0x13A0, 0x13F5 }, { 0x13F8, 0x13FD }, { 0x1401, 0x166C }, { 0x166F, 0x167F }, { 0x1681, 0x169A },
+	{ 0x16A0, 0x16EA }, { 0x16F1, 0x16F8 }, { 0x1700, 0x170C }, { 0x170E, 0x1711 }, { 0x1720, 0x1731 }, { 0x1740, 0x1751 }, { 0x1760, 0x176C }, { 0x176E, 0x1770 },
+	{ 0x1780, 0x17B3 }, { 0x17D7, 0x17D7 }, { 0x17DC, 0x17DC }, { 0x1820, 0x1878 }, { 0x1880, 0x1884 }, { 0x1887, 0x18A8 }, { 0x18AA, 0x18AA }, { 0x18B0, 0x18F5 },
+	{ 0x1900, 0x191E }, { 0x1950, 0x196D }, { 0x1970, 0x1974 }, { 0x1980, 0x19AB }, { 0x19B0, 0x19C9 }, { 0x1A00, 0x1A16 }, { 0x1A20, 0x1A54 }, { 0x1AA7, 0x1AA7 },
+	{ 0x1B05, 0x1B33 }, { 0x1B45, 0x1B4B }, { 0x1B83, 0x1BA0 }, { 0x1BAE, 0x1BAF }, { 0x1BBA, 0x1BE5 }, { 0x1C00, 0x1C23 }, { 0x1C4D, 0x1C4F }, { 0x1C5A, 0x1C7D },
+	{ 0x1C80, 0x1C88 }, { 0x1C90, 0x1CBA }, { 0x1CBD, 0x1CBF }, { 0x1CE9, 0x1CEC }, { 0x1CEE, 0x1CF3 }, { 0x1CF5, 0x1CF6 }, { 0x1CFA, 0x1CFA }, { 0x1D00, 0x1DBF },
+	{ 0x1E00, 0x1F15 }, { 0x1F18, 0x1F1D }, { 0x1F20, 0x1F45 }, { 0x1F48, 0x1F4D }, { 0x1F50, 0x1F57 }, { 0x1F59, 0x1F59 }, { 0x1F5B, 0x1F5B }, { 0x1F5D, 0x1F5D },
+	{ 0x1F5F, 0x1F7D }, { 0x1F80, 0x1FB4 }, { 0x1FB6, 0x1FBC }, { 0x1FBE, 0x1FBE }, { 0x1FC2, 0x1FC4 }, { 0x1FC6, 0x1FCC }, { 0x1FD0, 0x1FD3 }, { 0x1FD6, 0x1FDB },
+	{ 0x1FE0, 0x1FEC }, { 0x1FF2, 0x1FF4 }, { 0x1FF6, 0x1FFC }, { 0x2071, 0x2071 }, { 0x207F, 0x207F }, { 0x2090, 0x209C }, { 0x2102, 0x2102 }, { 0x2107, 0x2107 },
+	{ 0x210A, 0x2113 }, { 0x2115, 0x2115 }, { 0x2119, 0x211D }, { 0x2124, 0x2124 }, { 0x2126, 0x2126 }, { 0x2128, 0x2128 }, { 0x212A, 0x212D }, { 0x212F, 0x2139 },
+	{ 0x213C, 0x213F }, { 0x2145, 0x2149 }, { 0x214E, 0x214E }, { 0x2183, 0x2184 }, { 0x2C00, 0x2C2E }, { 0x2C30, 0x2C5E }, { 0x2C60, 0x2CE4 }, { 0x2CEB, 0x2CEE },
+	{ 0x2CF2, 0x2CF3 }, { 0x2D00, 0x2D25 }, { 0x2D27, 0x2D27 }, { 0x2D2D, 0x2D2D }, { 0x2D30, 0x2D67 }, { 0x2D6F, 0x2D6F }, { 0x2D80, 0x2D96 }, { 0x2DA0, 0x2DA6 },
+	{ 0x2DA8, 0x2DAE }, { 0x2DB0, 0x2DB6 }, { 0x2DB8, 0x2DBE }, { 0x2DC0, 0x2DC6 }, { 0x2DC8, 0x2DCE }, { 0x2DD0, 0x2DD6 }, { 0x2DD8, 0x2DDE }, { 0x2E2F, 0x2E2F },
+	{ 0x3005, 0x3006 }, { 0x3031, 0x3035 }, { 0x303B, 0x303C }, { 0x3041, 0x3096 }, { 0x309D, 0x309F }, { 0x30A1, 0x30FA }, { 0x30FC, 0x30FF }, { 0x3105, 0x312F },
+	{ 0x3131, 0x318E }, { 0x31A0, 0x31BF }, { 0x31F0, 0x31FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFC }, { 0xA000, 0xA48C }, { 0xA4D0, 0xA4FD }, { 0xA500, 0xA60C },
+	{ 0xA610, 0xA61F }, { 0xA62A, 0xA62B }, { 0xA640, 0xA66E }, { 0xA67F, 0xA69D }, { 0xA6A0, 0xA6E5 }, { 0xA717, 0xA71F }, { 0xA722, 0xA788 }, { 0xA78B, 0xA7BF },
+	{ 0xA7C2, 0xA7CA }, { 0xA7F5, 0xA801 }, { 0xA803, 0xA805 }, { 0xA807, 0xA80A }, { 0xA80C, 0xA822 }, { 0xA840, 0xA873 }, { 0xA882, 0xA8B3 }, { 0xA8F2, 0xA8F7 },
+	{ 0xA8FB, 0xA8FB }, { 0xA8FD, 0xA8FE }, { 0xA90A, 0xA925 }, { 0xA930, 0xA946 }, { 0xA960, 0xA97C }, { 0xA984, 0xA9B2 }, { 0xA9CF, 0xA9CF }, { 0xA9E0, 0xA9E4 },
+	{ 0xA9E6, 0xA9EF }, { 0xA9FA, 0xA9FE }, { 0xAA00, 0xAA28 }, { 0xAA40, 0xAA42 }, { 0xAA44, 0xAA4B }, { 0xAA60, 0xAA76 }, { 0xAA7A, 0xAA7A }, { 0xAA7E, 0xAAAF },
+	{ 0xAAB1, 0xAAB1 }, { 0xAAB5, 0xAAB6 }, { 0xAAB9, 0xAABD }, { 0xAAC0, 0xAAC0 }, { 0xAAC2, 0xAAC2 }, { 0xAADB, 0xAADD }, { 0xAAE0, 0xAAEA }, { 0xAAF2, 0xAAF4 },
+	{ 0xAB01, 0xAB06 }, { 0xAB09, 0xAB0E }, { 0xAB11, 0xAB16 }, { 0xAB20, 0xAB26 }, { 0xAB28, 0xAB2E }, { 0xAB30, 0xAB5A }, { 0xAB5C, 0xAB69 }, { 0xAB70, 0xABE2 },
+	{ 0xAC00, 0xD7A3 }, { 0xD7B0, 0xD7C6 }, { 0xD7CB, 0xD7FB }, { 0xF900, 0xFA6D }, { 0xFA70, 0xFAD9 }, { 0xFB00, 0xFB06 }, { 0xFB13, 0xFB17 }, { 0xFB1D, 0xFB1D },
+	{ 0xFB1F, 0xFB28 }, { 0xFB2A, 0xFB36 }, { 0xFB38, 0xFB3C }, { 0xFB3E, 0xFB3E }, { 0xFB40, 0xFB41 }, { 0xFB43, 0xFB44 }, { 0xFB46, 0xFBB1 }, { 0xFBD3, 0xFD3D },
+	{ 0xFD50, 0xFD8F }, { 0xFD92, 0xFDC7 }, { 0xFDF0, 0xFDFB }, { 0xFE70, 0xFE74 }, { 0xFE76, 0xFEFC }, { 0xFF21, 0xFF3A }, { 0xFF41, 0xFF5A }, { 0xFF66, 0xFFBE },
+	{ 0xFFC2, 0xFFC7 }, { 0xFFCA, 0xFFCF }, { 0xFFD2, 0xFFD7 }, { 0xFFDA, 0xFFDC },
+};
 
-	if (flag & 0b00000001) // ShouldGatherForLocalization: no Transient
-		return std::nullopt;
+// One bit per BMP code point, built at compile time from a range list.
+class bmp_property_set
+{
+public:
+	template <size_t N>
+	constexpr explicit bmp_property_set(code_point_range const (&ranges)[N])
+	{
+		for (auto const& range : ranges)
+		{
+			for (uint32_t ch = range.first; ch <= range.last; ch = (ch | 63) + 1)
+			{
+				const auto last = std::min<uint32_t>(range.last, ch | 63);
+				const auto high = last & 63;
+				const auto low = ch & 63;
+				const auto mask = (high == 63 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << (high + 1)) - 1) & ~((uint64_t{ 1 } << low) - 1);
+				bits[ch >> 6] |= mask;
+			}
+		}
+	}
 
-	const auto history = *reinterpret_cast<const char*>(buffer.data() + index);
-	index += 1;
+	constexpr bool contains(uint16_t ch) const
+	{
+		return (bits[ch >> 6] >> (ch & 63)) & 1;
+	}
 
-	if (history != 0) // support only ETextHistoryType::Base right now, should we support None = -1?
-		return std::nullopt;
+private:
+	std::array<uint64_t, 0x10000 / 64> bits{};
+};
+
+constexpr auto GOOD_CHARS = bmp_property_set(GOOD_CHAR_RANGES);
+constexpr auto WHITE_SPACES = bmp_property_set(WHITE_SPACE_RANGES);
+constexpr auto LETTERS = bmp_property_set(LETTER_RANGES);
+
+inline bool good_ch(char16_t ch)
+{
+	return GOOD_CHARS.contains(ch);
+}
+
+// Number of leading printable ASCII code units (0x20-0x7e) of the count units at index. Char is the type the units are
+// read as: char for ANSI, char16_t for UTF-16.
+template <typename Char>
+size_t printable_ascii_run(byte_span buffer, size_t index, size_t count)
+{
+	static_assert(sizeof(Char) == 1 || sizeof(Char) == 2);
+	[[maybe_unused]] const auto data = buffer.data() + index;
+	size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 32 / sizeof(Char) <= count; i += 32 / sizeof(Char))
+	{
+		const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * sizeof(Char)));
+		__m256i printable;
+		if constexpr (sizeof(Char) == 1)
+			printable = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1F)), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), v));
+		else
+			printable = _mm256_and_si256(_mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x1F)), _mm256_cmpgt_epi16(_mm256_set1_epi16(0x7F), v));
+		const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(printable));
+		if (mask != 0xFFFFFFFF)
+			return i + std::countr_zero(~mask) / sizeof(Char);
+	}
+#endif
+#if defined(_M_X64) || defined(__SSE2__)
+	for (; i + 16 / sizeof(Char) <= count; i += 16 / sizeof(Char))
+	{
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * sizeof(Char)));
+		__m128i printable;
+		if constexpr (sizeof(Char) == 1)
+			printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)), _mm_cmpgt_epi8(_mm_set1_epi8(0x7F), v));
+		else
+			printable = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16(0x1F)), _mm_cmpgt_epi16(_mm_set1_epi16(0x7F), v));
+		const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(printable));
+		if (mask != 0xFFFF)
+			return i + std::countr_zero(~mask) / sizeof(Char);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		const auto ch = read_as<std::conditional_t<sizeof(Char) == 1, uint8_t, uint16_t>>(buffer, index + i * sizeof(Char));
+		if (!(0x20 <= ch && ch <= 0x7E))
+			break;
+	}
+	return i;
+}
+
+// Whether all count code units at index pass good_ch, which also rules out embedded nulls. Printable ASCII blocks are
+// accepted in bulk, only the rest goes through the character class lookup.
+template <typename Char>
+bool valid_run(byte_span buffer, size_t index, size_t count)
+{
+	size_t i = 0;
+	while (i < count)
+	{
+		i += printable_ascii_run<Char>(buffer, index + i * sizeof(Char), count - i);
+		if (i == count)
+			break;
+		if (!good_ch(read_code_unit<Char>(buffer, index + i * sizeof(Char))))
+			return false;
+		++i;
+	}
+	return true;
+}
+
+// Length in code units of the null-terminated run at index, nullopt if a bad character or the end of the buffer
+// comes first.
+template <typename Char>
+std::optional<size_t> valid_run_to_null(byte_span buffer, size_t index)
+{
+	const auto available = (buffer.size() - index) / sizeof(Char);
+	size_t i = 0;
+	while (true)
+	{
+		i += printable_ascii_run<Char>(buffer, index + i * sizeof(Char), available - i);
+		if (i == available)
+			return std::nullopt;
+		const auto ch = read_code_unit<Char>(buffer, index + i * sizeof(Char));
+		if (ch == 0)
+			return i;
+		if (!good_ch(ch))
+			return std::nullopt;
+		++i;
+	}
+}
+
+template <typename Char>
+void decode_run(byte_span buffer, size_t index, size_t count, char16_t * out)
+{
+	if constexpr (sizeof(Char) == 2)
+	{
+		std::memcpy(out, buffer.data() + index, count * 2);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = read_code_unit<Char>(buffer, index + i);
+	}
+}
+
+// A validated string in place in the scanned buffer. Detectors only look at these, the characters get decoded into an
+// owned string once the whole text is accepted.
+struct string_view_in_buffer
+{
+	size_t index = 0;  // first character
+	size_t length = 0; // characters without the terminating null
+	bool utf16 = false;
+
+	size_t size() const
+	{
+		return length;
+	}
+
+	char16_t at(byte_span buffer, size_t i) const
+	{
+		if (utf16)
+			return read_code_unit<char16_t>(buffer, index + 2 * i);
+		return read_code_unit<char>(buffer, index + i);
+	}
+
+	void decode(byte_span buffer, char16_t * out) const
+	{
+		if (utf16)
+			decode_run<char16_t>(buffer, index, length, out);
+		else
+			decode_run<char>(buffer, index, length, out);
+	}
+
+	std::u16string decode(byte_span buffer) const
+	{
+		auto s = std::u16string(length, u'\0');
+		decode(buffer, s.data());
+		return s;
+	}
+
+	std::u16string_view decode(byte_span buffer, text_arena & arena) const
+	{
+		const auto data = arena.allocate(length);
+		decode(buffer, data);
+		return { data, length };
+	}
+};
+
+struct text_candidate
+{
+	string_view_in_buffer ns;
+	string_view_in_buffer key;
+	string_view_in_buffer s;
+};
+
+// Counts how much of the scanned data ends up in owned strings, reported by -stats.
+struct scan_counters
+{
+	uint64_t bytes_scanned = 0;
+	uint64_t strings_checked = 0; // strings validated in place
+	uint64_t strings_decoded = 0; // strings decoded into owned strings
+	uint64_t string_cache_hits = 0; // strings another detector already validated at the same offset
+	uint64_t chunks_scanned = 0; // chunks of large buffers
+	uint64_t chunks_scanned_by_free_threads = 0;
+
+	scan_counters & operator+=(scan_counters const& other)
+	{
+		bytes_scanned += other.bytes_scanned;
+		strings_checked += other.strings_checked;
+		strings_decoded += other.strings_decoded;
+		string_cache_hits += other.string_cache_hits;
+		chunks_scanned += other.chunks_scanned;
+		chunks_scanned_by_free_threads += other.chunks_scanned_by_free_threads;
+		return *this;
+	}
+};
+
+// Reads the length-prefixed FStrings of one scan. Detectors probing nearby positions read the same strings over and
+// over, a small direct-mapped cache keyed by offset makes sure each of them is validated once.
+class fstring_reader
+{
+public:
+	fstring_reader(byte_span buffer, scan_counters & counters)
+		: buffer(buffer), counters(counters)
+	{
+	}
+
+	// Reads the FString at index and moves index past it.
+	std::optional<string_view_in_buffer> read(size_t & index)
+	{
+		auto & entry = cache[index % CACHE_SIZE];
+		if (entry.index == index)
+		{
+			++counters.string_cache_hits;
+		}
+		else
+		{
+			entry.index = index;
+			entry.next = index;
+			entry.s = validate(entry.next);
+		}
+		if (entry.s.has_value())
+			index = entry.next;
+		return entry.s;
+	}
+
+	const byte_span buffer;
+	scan_counters & counters;
+
+private:
+	static constexpr size_t CACHE_SIZE = 64;
+
+	struct cache_entry
+	{
+		size_t index = -1;
+		size_t next = 0;
+		std::optional<string_view_in_buffer> s;
+	};
 
-	const auto read_string = [&] () -> std::optional<std::wstring> {
+	std::optional<string_view_in_buffer> validate(size_t & index)
+	{
 		if (buffer.size() < index + 4)
 			return std::nullopt;
-		auto length = static_cast<int64_t>(*reinterpret_cast<const int*>(buffer.data() + index));
+		auto length = static_cast<int64_t>(read_as<int>(buffer, index));
 		index += 4;
 		if (length == 0)
-			return L"";
+			return string_view_in_buffer{ index, 0, false };
 		if (length < 0)
 		{
 			length = -length;
 			if (buffer.size() < index + 2 * length)
 				return std::nullopt;
-			if (buffer[index + 2 * length - 2] != 0)
+			if (buffer[index + 2 * length - 2] != std::byte{ 0 })
 				return std::nullopt;
-			if (buffer[index + 2 * length - 1] != 0)
+			if (buffer[index + 2 * length - 1] != std::byte{ 0 })
 				return std::nullopt;
-			std::wstring s;
-			for (size_t i = index; i < index + 2 * length - 2; i += 2)
-			{
-				const auto ch = *reinterpret_cast<const wchar_t*>(buffer.data() + i);
-				if (ch == 0)
-					return std::nullopt;
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
-			}
+			if (!valid_run<char16_t>(buffer, index, length - 1))
+				return std::nullopt;
+			const auto s = string_view_in_buffer{ index, static_cast<size_t>(length - 1), true };
 			index += length * 2;
+			++counters.strings_checked;
 			return s;
 		}
 		else
 		{
 			if (buffer.size() < index + length)
 				return std::nullopt;
-			if (buffer[index + length - 1] != 0)
+			if (buffer[index + length - 1] != std::byte{ 0 })
 				return std::nullopt;
-			std::wstring s;
-			for (size_t i = index; i < index + length - 1; ++i)
-			{
-				const auto ch = buffer[i];
-				if (ch == 0)
-					return std::nullopt;
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
-			}
+			if (!valid_run<char>(buffer, index, length - 1))
+				return std::nullopt;
+			const auto s = string_view_in_buffer{ index, static_cast<size_t>(length - 1), false };
 			index += length;
+			++counters.strings_checked;
 			return s;
 		}
-	};
+	}
+
+	std::array<cache_entry, CACHE_SIZE> cache;
+};
+
+bool very_good_key(byte_span buffer, string_view_in_buffer const& key)
+{
+	if (key.size() != 32)
+		return false;
+	for (size_t i = 0; i < key.size(); ++i)
+	{
+		const auto c = key.at(buffer, i);
+		if (!((u'0' <= c && c <= u'9') || (u'A' <= c && c <= u'F')))
+			return false;
+	}
+	return true;
+}
+
+bool all_white_spaces(byte_span buffer, string_view_in_buffer const& s)
+{
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		const auto c = s.at(buffer, i);
+		if (!WHITE_SPACES.contains(c))
+			return false;
+	}
+	return true;
+}
+
+bool has_letter(byte_span buffer, string_view_in_buffer const& s)
+{
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		const auto c = s.at(buffer, i);
+		if (LETTERS.contains(c))
+			return true;
+	}
+	return false;
+}
 
-	const auto ns = read_string();
+std::optional<std::pair<text_candidate, size_t>> try_read_blueprint_text(fstring_reader & strings, size_t index)
+{
+	const auto buffer = strings.buffer;
+
+	constexpr std::string_view BLUEPRINT_TEXT_SIGNATURE = "\x29\x01"; // EX_TextConst, EBlueprintTextLiteralType::LocalizedText
+
+	if (!test_signature(BLUEPRINT_TEXT_SIGNATURE, buffer, index))
+		return std::nullopt;
+
+	index += BLUEPRINT_TEXT_SIGNATURE.size();
+
+	const auto read_to_null = [&] () -> std::optional<string_view_in_buffer> {
+		if (buffer.size() <= index)
+			return std::nullopt;
+
+		if (buffer[index] == std::byte{ 0x1F }) // ANSI (EX_StringConst)
+		{
+			++index;
+			const auto length = valid_run_to_null<char>(buffer, index);
+			if (!length.has_value())
+				return std::nullopt;
+			const auto s = string_view_in_buffer{ index, length.value(), false };
+			index += length.value() + 1;
+			++strings.counters.strings_checked;
+			return s;
+		}
+
+		if (buffer[index] == std::byte{ 0x34 }) // UTF-16 (EX_UnicodeStringConst)
+		{
+			++index;
+			const auto length = valid_run_to_null<char16_t>(buffer, index);
+			if (!length.has_value())
+				return std::nullopt;
+			const auto s = string_view_in_buffer{ index, length.value(), true };
+			index += (length.value() + 1) * 2;
+			++strings.counters.strings_checked;
+			return s;
+		}
+
+		return std::nullopt;
+	};
+
+	const auto s = read_to_null();
+	if (!s.has_value())
+		return std::nullopt;
+	if (s->size() == 0)
+		return std::nullopt;
+	const auto key = read_to_null();
+	if (!key.has_value())
+		return std::nullopt;
+	if (key->size() == 0)
+		return std::nullopt;
+	if (128 < key->size())   // static const int32 InlineStringSize = 128;
+		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
+	if (all_white_spaces(buffer, s.value()))
+		return std::nullopt;
+	const auto ns = read_to_null();
 	if (!ns.has_value())
 		return std::nullopt;
 	if (128 < ns->size())    // static const int32 InlineStringSize = 128;
 		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
-	const auto key = read_string();
+	int good_score = 0;
+	if (very_good_key(buffer, key.value()))
+		good_score += 10;
+	if (has_letter(buffer, s.value()))
+		good_score += 5;
+	if (good_score < 5)
+		return std::nullopt;
+
+	return std::pair{ text_candidate{ ns.value(), key.value(), s.value() }, index };
+}
+
+std::optional<std::pair<text_candidate, size_t>> try_read_ftext(fstring_reader & strings, size_t index)
+{
+	const auto buffer = strings.buffer;
+
+	if (buffer.size() < index + 5)
+		return std::nullopt;
+
+	const auto flag = read_as<int>(buffer, index);
+	index += 4;
+
+	if (0b00011111 < flag) // highest flag right now: InitializedFromString = (1<<4)
+		return std::nullopt;
+
+	if (flag & 0b00000100) // ConvertedProperty = (1 << 2) never set in cooked text
+		return std::nullopt;
+
+	if (flag & 0b00010000) // InitializedFromString = (1 << 4) never set in cooked text
+		return std::nullopt;
+
+	// Strange, but some probably localizable text using this flag
+	//if (flag & 0b00000010) // ShouldGatherForLocalization: no CultureInvariant
+	//	return std::nullopt;
+
+	if (flag & 0b00000001) // ShouldGatherForLocalization: no Transient
+		return std::nullopt;
+
+	const auto history = read_as<char>(buffer, index);
+	index += 1;
+
+	if (history != 0) // support only ETextHistoryType::Base right now, should we support None = -1?
+		return std::nullopt;
+
+	const auto ns = strings.read(index);
+	if (!ns.has_value())
+		return std::nullopt;
+	if (128 < ns->size())    // static const int32 InlineStringSize = 128;
+		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
+	const auto key = strings.read(index);
 	if (!key.has_value())
 		return std::nullopt;
 	if (key->size() == 0)
 		return std::nullopt;
 	if (128 < key->size())   // static const int32 InlineStringSize = 128;
 		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
-	const auto s = read_string();
+	const auto s = strings.read(index);
 	if (!s.has_value())
 		return std::nullopt;
 	if (s->size() == 0)
 		return std::nullopt;
-	if (all_white_spaces(s.value()))
+	if (all_white_spaces(buffer, s.value()))
 		return std::nullopt;
 
 	int good_score = 0;
-	if (very_good_key(key.value()))
+	if (very_good_key(buffer, key.value()))
 		good_score += 10;
-	if (has_letter(s.value()))
+	if (has_letter(buffer, s.value()))
 		good_score += 5;
 
 	const auto current_index = index;
 	if (good_score < 10)
 	{
-		const auto impostor_check = read_string();
+		const auto impostor_check = strings.read(index);
 		if (impostor_check.has_value() && 0 < impostor_check->size())
 			good_score -= 5;
 	}
@@ -264,206 +941,819 @@ std::optional<std::pair<FText, size_t>> try_read_ftext(std::vector<char> const&
 	if (good_score < 5)
 		return std::nullopt;
 
-	return std::pair{ FText{ ns.value(), key.value(), s.value() }, current_index };
+	return std::pair{ text_candidate{ ns.value(), key.value(), s.value() }, current_index };
 }
 
-std::optional<std::pair<FText, size_t>> try_read_very_good_raw_text(std::vector<char> const& buffer, size_t index)
+std::optional<std::pair<text_candidate, size_t>> try_read_very_good_raw_text(fstring_reader & strings, size_t index)
 {
-	const auto read_string = [&] () -> std::optional<std::wstring> {
-		if (buffer.size() < index + 4)
-			return std::nullopt;
-		auto length = static_cast<int64_t>(*reinterpret_cast<const int*>(buffer.data() + index));
-		index += 4;
-		if (length == 0)
-			return L"";
-		if (length < 0)
-		{
-			length = -length;
-			if (buffer.size() < index + 2 * length)
-				return std::nullopt;
-			if (buffer[index + 2 * length - 2] != 0)
-				return std::nullopt;
-			if (buffer[index + 2 * length - 1] != 0)
-				return std::nullopt;
-			std::wstring s;
-			for (size_t i = index; i < index + 2 * length - 2; i += 2)
-			{
-				const auto ch = *reinterpret_cast<const wchar_t*>(buffer.data() + i);
-				if (ch == 0)
-					return std::nullopt;
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
-			}
-			index += length * 2;
-			return s;
-		}
-		else
-		{
-			if (buffer.size() < index + length)
-				return std::nullopt;
-			if (buffer[index + length - 1] != 0)
-				return std::nullopt;
-			std::wstring s;
-			for (size_t i = index; i < index + length - 1; ++i)
-			{
-				const auto ch = buffer[i];
-				if (ch == 0)
-					return std::nullopt;
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
-			}
-			index += length;
-			return s;
-		}
-	};
+	const auto buffer = strings.buffer;
 
-	const auto ns = read_string();
+	const auto ns = strings.read(index);
 	if (!ns.has_value())
 		return std::nullopt;
 	if (128 < ns->size())    // static const int32 InlineStringSize = 128;
 		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
 	if (ns->size() != 0)
 		return std::nullopt; // only empty namespaces supported!
-	const auto key = read_string();
+	const auto key = strings.read(index);
 	if (!key.has_value())
 		return std::nullopt;
 	if (key->size() == 0)
 		return std::nullopt;
 	if (128 < key->size())   // static const int32 InlineStringSize = 128;
 		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
-	if (!very_good_key(key.value()))
+	if (!very_good_key(buffer, key.value()))
 		return std::nullopt; // only very good keys supported!
-	const auto s = read_string();
+	const auto s = strings.read(index);
 	if (!s.has_value())
 		return std::nullopt;
 	if (s->size() == 0)
 		return std::nullopt;
-	if (all_white_spaces(s.value()))
+	if (all_white_spaces(buffer, s.value()))
 		return std::nullopt;
-	return std::pair{ FText{ ns.value(), key.value(), s.value() }, index };
+	return std::pair{ text_candidate{ ns.value(), key.value(), s.value() }, index };
 }
 
-std::optional<std::pair<std::vector<FText>, size_t>> try_read_string_table(std::vector<char> const& buffer, size_t index)
+std::optional<std::pair<std::vector<text_candidate>, size_t>> try_read_string_table(fstring_reader & strings, size_t index)
 {
+	const auto buffer = strings.buffer;
+
 	if (buffer.size() < index + 12)
 		return std::nullopt;
 
-	const auto read_string = [&] () -> std::optional<std::wstring> {
-		if (buffer.size() < index + 4)
+	const auto ns = strings.read(index);
+	if (!ns.has_value())
+		return std::nullopt;
+	if (128 < ns->size())    // static const int32 InlineStringSize = 128;
+		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
+
+	if (buffer.size() < index + 8)
+		return std::nullopt;
+
+	const auto size = read_as<int>(buffer, index);
+	index += 4;
+	if (size < 1)
+		return std::nullopt;
+
+	std::vector<text_candidate> table;
+
+	// size maybe very large
+	//table.reserve(size);
+
+	int good_score = 0;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		const auto key = strings.read(index);
+		if (!key.has_value())
 			return std::nullopt;
-		auto length = static_cast<int64_t>(*reinterpret_cast<const int*>(buffer.data() + index));
-		index += 4;
-		if (length == 0)
-			return L"";
-		if (length < 0)
+		if (key->size() == 0)
+			return std::nullopt;
+		if (128 < key->size())   // static const int32 InlineStringSize = 128;
+			return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
+		const auto s = strings.read(index);
+		if (!s.has_value())
+			return std::nullopt;
+		if (s->size() == 0)
 		{
-			length = -length;
-			if (buffer.size() < index + 2 * length)
-				return std::nullopt;
-			if (buffer[index + 2 * length - 2] != 0)
-				return std::nullopt;
-			if (buffer[index + 2 * length - 1] != 0)
-				return std::nullopt;
-			std::wstring s;
-			for (size_t i = index; i < index + 2 * length - 2; i += 2)
+			good_score -= 2;
+			continue;
+		}
+		if (all_white_spaces(buffer, s.value()))
+		{
+			good_score -= 1;
+			continue;
+		}
+		table.push_back(text_candidate{ ns.value(), key.value(), s.value() });
+		good_score += 2;
+	}
+
+	if (good_score < 0)
+		return std::nullopt;
+
+	if (buffer.size() < index + 4)
+		return std::nullopt;
+
+	const auto metadata_size = read_as<int>(buffer, index);
+	index += 4;
+	if (metadata_size < 0)
+		return std::nullopt;
+
+	return std::pair{ std::move(table), index };
+}
+
+// The threads that may run at the same time under the -j cap and how many of them are free to start right now.
+// A large buffer takes free threads for its chunks and gives them back once they are done.
+class thread_budget
+{
+public:
+	thread_budget(size_t jobs, size_t available)
+		: jobs(jobs), available(available)
+	{
+	}
+
+	bool try_acquire()
+	{
+		auto count = available.load();
+		while (count != 0)
+			if (available.compare_exchange_weak(count, count - 1))
+				return true;
+		return false;
+	}
+
+	void release(size_t count = 1)
+	{
+		available += count;
+	}
+
+	const size_t jobs;
+
+private:
+	std::atomic<size_t> available;
+};
+
+// Runs task(i, worker) for every item on `jobs` threads. Items are dealt out largest first, each worker takes from the
+// front of its own queue and, once it runs dry, steals from the back of the others. A worker that finds nothing left
+// to steal hands its thread to idle, where the tasks still running can pick it up.
+template <typename Task>
+void run_work_stealing(std::vector<uintmax_t> const& weights, size_t jobs, Task const& task, thread_budget * idle = nullptr)
+{
+	std::vector<size_t> order(weights.size());
+	std::iota(order.begin(), order.end(), size_t{ 0 });
+	std::stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b) {
+		return weights[b] < weights[a];
+	});
+
+	struct worker_queue
+	{
+		std::mutex mutex;
+		std::deque<size_t> items;
+	};
+
+	auto queues = std::vector<worker_queue>(jobs);
+	for (size_t i = 0; i < order.size(); ++i)
+		queues[i % jobs].items.push_back(order[i]);
+
+	const auto next_item = [&] (size_t worker) -> std::optional<size_t> {
+		for (size_t i = 0; i < jobs; ++i)
+		{
+			auto & queue = queues[(worker + i) % jobs];
+			const auto lock = std::lock_guard{ queue.mutex };
+			if (queue.items.empty())
+				continue;
+			size_t item = 0;
+			if (i == 0)
 			{
-				const auto ch = *reinterpret_cast<const wchar_t*>(buffer.data() + i);
-				if (ch == 0)
-					return std::nullopt;
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
+				item = queue.items.front();
+				queue.items.pop_front();
 			}
-			index += length * 2;
-			return s;
+			else
+			{
+				item = queue.items.back();
+				queue.items.pop_back();
+			}
+			return item;
+		}
+		return std::nullopt;
+	};
+
+	std::vector<std::jthread> workers;
+	workers.reserve(jobs);
+	for (size_t worker = 0; worker < jobs; ++worker)
+	{
+		workers.emplace_back([&, worker] () {
+			while (const auto item = next_item(worker))
+				task(item.value(), worker);
+			if (idle != nullptr)
+				idle->release();
+		});
+	}
+}
+
+struct text_detectors
+{
+	bool blueprint = false;
+	bool text_property = false;
+	bool string_table = false;
+	bool very_good_raw_text = false;
+};
+
+// Tries every enabled detector at index, appends what was found and returns the index to continue from.
+std::optional<size_t> scan_at(fstring_reader & strings, size_t index, text_detectors const& detectors, string_pool & pool, text_arena & arena, std::vector<FText> & texts)
+{
+	const auto accept = [&] (text_candidate const& text) {
+		auto key = text_key::parse_guid(text.key.size(), [&] (size_t i) { return text.key.at(strings.buffer, i); });
+		if (!key.has_value())
+		{
+			key = text_key::from_id(pool.intern(text.key.decode(strings.buffer)));
+			++strings.counters.strings_decoded;
+		}
+		texts.push_back(FText{ pool.intern(text.ns.decode(strings.buffer)), key.value(), text.s.decode(strings.buffer, arena), 0 });
+		strings.counters.strings_decoded += 2; // namespace and string, GUID keys are parsed in place
+	};
+
+	if (detectors.blueprint)
+	{
+		if (const auto text = try_read_blueprint_text(strings, index); text.has_value())
+		{
+			accept(text.value().first);
+			return text.value().second;
+		}
+	}
+	if (detectors.text_property)
+	{
+		if (const auto text = try_read_ftext(strings, index); text.has_value())
+		{
+			accept(text.value().first);
+			return text.value().second;
+		}
+	}
+	if (detectors.string_table)
+	{
+		if (const auto table = try_read_string_table(strings, index); table.has_value())
+		{
+			for (auto const& text : table.value().first)
+				accept(text);
+			return table.value().second;
+		}
+	}
+	if (detectors.very_good_raw_text)
+	{
+		if (const auto text = try_read_very_good_raw_text(strings, index); text.has_value())
+		{
+			accept(text.value().first);
+			return text.value().second;
+		}
+	}
+	return std::nullopt;
+}
+
+constexpr size_t CHUNK_SCAN_MIN_BUFFER_SIZE = 32 * 1024 * 1024;
+constexpr size_t CHUNK_SCAN_MIN_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// Scans the positions [begin, end) of buffer and returns the index the scan stopped at, which is past end if the last
+// match ran over it. Large buffers are split into chunks, scanned by the calling thread and by as many threads as
+// become free in threads while it works through them.
+size_t scan_buffer(byte_span buffer, size_t begin, size_t end, text_detectors const& detectors, thread_budget & threads, string_pool & pool, text_arena & arena, scan_counters & counters, std::vector<FText> & texts)
+{
+	if (end <= begin)
+		return begin;
+
+	counters.bytes_scanned += end - begin;
+
+	if (threads.jobs <= 1 || end - begin < CHUNK_SCAN_MIN_BUFFER_SIZE)
+	{
+		auto strings = fstring_reader{ buffer, counters };
+		size_t i = begin;
+		while (i < end)
+		{
+			if (const auto next = scan_at(strings, i, detectors, pool, arena, texts); next.has_value())
+				i = next.value();
+			else
+				++i;
+		}
+		return i;
+	}
+
+	// Every chunk is scanned on its own as if the serial scan started right at its first byte. Detectors may read
+	// past the end of the chunk, so a match can start in one chunk and end in the next.
+	struct chunk_scan
+	{
+		struct match
+		{
+			size_t begin;
+			size_t end;
+			size_t text_count;
+		};
+
+		size_t begin = 0;
+		size_t end = 0;
+		std::vector<match> matches;
+		std::vector<FText> texts;
+		text_arena arena;
+		scan_counters counters;
+	};
+
+	// The chunks only depend on the -j cap, not on how many threads turn up, so the result is always the same.
+	const auto chunk_size = std::max(CHUNK_SCAN_MIN_CHUNK_SIZE, (end - begin) / (threads.jobs * 4) + 1);
+	auto chunks = std::vector<chunk_scan>((end - begin + chunk_size - 1) / chunk_size);
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunks[i].begin = begin + i * chunk_size;
+		chunks[i].end = std::min(end, chunks[i].begin + chunk_size);
+	}
+
+	std::atomic<size_t> next_chunk = 0;
+	std::atomic<size_t> chunks_scanned_by_helpers = 0;
+	const auto scan_chunk = [&] (chunk_scan & chunk) {
+		auto strings = fstring_reader{ buffer, chunk.counters };
+		for (size_t index = chunk.begin; index < chunk.end; )
+		{
+			const auto text_count = chunk.texts.size();
+			if (const auto next = scan_at(strings, index, detectors, pool, chunk.arena, chunk.texts); next.has_value())
+			{
+				chunk.matches.push_back({ index, next.value(), chunk.texts.size() - text_count });
+				index = next.value();
+			}
+			else
+			{
+				++index;
+			}
+		}
+	};
+	{
+		std::vector<std::jthread> helpers;
+		while (true)
+		{
+			// before every chunk, put the threads that became free to work on the ones left
+			while (next_chunk.load() + helpers.size() + 1 < chunks.size() && threads.try_acquire())
+			{
+				helpers.emplace_back([&] () {
+					for (size_t i; (i = next_chunk++) < chunks.size(); )
+					{
+						scan_chunk(chunks[i]);
+						++chunks_scanned_by_helpers;
+					}
+				});
+			}
+			const auto i = next_chunk++;
+			if (chunks.size() <= i)
+				break;
+			scan_chunk(chunks[i]);
+		}
+		for (auto & helper : helpers)
+			helper.join();
+		threads.release(helpers.size());
+	}
+	counters.chunks_scanned += chunks.size();
+	counters.chunks_scanned_by_free_threads += chunks_scanned_by_helpers;
+
+	// Stitch the chunks together the way the serial scan would walk them. Positions between chunk matches were
+	// already probed without success, so the serial scan reaches the same next match. Only when the serial scan
+	// resumes strictly inside a match the chunk took (because the previous match ran over the chunk border) the
+	// skipped positions have to be probed again, until both scans line up.
+	auto strings = fstring_reader{ buffer, counters };
+	size_t index = begin;
+	for (auto & chunk : chunks)
+	{
+		counters.strings_checked += chunk.counters.strings_checked;
+		counters.strings_decoded += chunk.counters.strings_decoded;
+		counters.string_cache_hits += chunk.counters.string_cache_hits;
+		arena.splice(std::move(chunk.arena));
+		size_t match = 0;
+		size_t text = 0;
+		while (index < chunk.end)
+		{
+			while (match < chunk.matches.size() && chunk.matches[match].end <= index)
+			{
+				text += chunk.matches[match].text_count;
+				++match;
+			}
+			if (match == chunk.matches.size())
+			{
+				index = chunk.end;
+				break;
+			}
+			auto const& m = chunk.matches[match];
+			if (index <= m.begin)
+			{
+				std::move(chunk.texts.begin() + text, chunk.texts.begin() + text + m.text_count, std::back_inserter(texts));
+				text += m.text_count;
+				++match;
+				index = m.end;
+				continue;
+			}
+			if (const auto next = scan_at(strings, index, detectors, pool, arena, texts); next.has_value())
+				index = next.value();
+			else
+				++index;
+		}
+	}
+	return index;
+}
+
+// Bounds-checked sequential reader, any read past the end clears `ok` and yields zeroes.
+struct archive_reader
+{
+	byte_span buffer;
+	size_t index = 0;
+	bool ok = true;
+
+	template <typename T>
+	T read()
+	{
+		if (!ok || buffer.size() < index || buffer.size() - index < sizeof(T))
+		{
+			ok = false;
+			return T{};
+		}
+		const auto value = read_as<T>(buffer, index);
+		index += sizeof(T);
+		return value;
+	}
+
+	void skip(size_t size)
+	{
+		if (!ok || buffer.size() < index || buffer.size() - index < size)
+		{
+			ok = false;
+			return;
+		}
+		index += size;
+	}
+
+	// Location of a serialized FString without the terminating null, decoded only when needed.
+	string_view_in_buffer read_fstring_view()
+	{
+		auto length = static_cast<int64_t>(read<int32_t>());
+		if (!ok || length == 0)
+			return {};
+		const bool utf16 = length < 0;
+		if (utf16)
+			length = -length;
+		const auto start = index;
+		skip(static_cast<size_t>(length) * (utf16 ? 2 : 1));
+		if (!ok)
+			return {};
+		return { start, static_cast<size_t>(length) - 1, utf16 };
+	}
+
+	// Raw characters of a serialized FString without the terminating null.
+	byte_span read_fstring()
+	{
+		const auto view = read_fstring_view();
+		return buffer.subspan(view.index, view.length * (view.utf16 ? 2 : 1));
+	}
+};
+
+struct FPackageFileSummary
+{
+	int32_t legacy_file_version = 0;
+	int32_t file_version_ue4 = 0;
+	int32_t file_version_ue5 = 0;
+	int32_t total_header_size = 0;
+	uint32_t package_flags = 0;
+	int32_t name_count = 0;
+	int32_t name_offset = 0;
+
+	// only known if the version of the package could be determined (export_count < 0 otherwise)
+	int32_t export_count = -1;
+	int32_t export_offset = 0;
+	int32_t import_count = -1;
+	int32_t import_offset = 0;
+};
+
+constexpr uint32_t PACKAGE_FILE_TAG = 0x9E2A83C1;
+constexpr uint32_t PKG_FilterEditorOnly = 0x80000000;
+
+constexpr int32_t VER_UE4_LOAD_FOR_EDITOR_GAME = 365;
+constexpr int32_t VER_UE4_SERIALIZE_TEXT_IN_PACKAGES = 459;
+constexpr int32_t VER_UE4_COOKED_ASSETS_IN_EDITOR_SUPPORT = 485;
+constexpr int32_t VER_UE4_NAME_HASHES_SERIALIZED = 504;
+constexpr int32_t VER_UE4_PRELOAD_DEPENDENCIES_IN_COOKED_EXPORTS = 507;
+constexpr int32_t VER_UE4_TemplateIndex_IN_COOKED_EXPORTS = 508;
+constexpr int32_t VER_UE4_64BIT_EXPORTMAP_SERIALSIZES = 511;
+constexpr int32_t VER_UE4_ADDED_PACKAGE_SUMMARY_LOCALIZATION_ID = 516;
+constexpr int32_t VER_UE4_NON_OUTER_PACKAGE_IMPORT = 520;
+constexpr int32_t VER_UE4_LATEST = 522; // what unversioned UE4 packages are cooked with
+
+constexpr int32_t VER_UE5_OPTIONAL_RESOURCES = 1003;
+constexpr int32_t VER_UE5_REMOVE_OBJECT_EXPORT_PACKAGE_GUID = 1005;
+constexpr int32_t VER_UE5_TRACK_OBJECT_EXPORT_IS_INHERITED = 1006;
+constexpr int32_t VER_UE5_ADD_SOFTOBJECTPATH_LIST = 1008;
+constexpr int32_t VER_UE5_SCRIPT_SERIALIZATION_OFFSET = 1010;
+constexpr int32_t VER_UE5_PACKAGE_SAVED_HASH = 1016; // summary layout changes, not supported
+
+std::optional<FPackageFileSummary> read_package_summary(byte_span buffer)
+{
+	auto ar = archive_reader{ buffer };
+	FPackageFileSummary summary;
+
+	if (ar.read<uint32_t>() != PACKAGE_FILE_TAG)
+		return std::nullopt;
+
+	summary.legacy_file_version = ar.read<int32_t>();
+	if (!(-8 <= summary.legacy_file_version && summary.legacy_file_version <= -2)) // -8 is UE5.0+, -2 is the oldest with custom versions
+		return std::nullopt;
+	if (summary.legacy_file_version != -4)
+		ar.skip(sizeof(int32_t)); // LegacyUE3Version
+	summary.file_version_ue4 = ar.read<int32_t>();
+	if (summary.legacy_file_version <= -8)
+		summary.file_version_ue5 = ar.read<int32_t>();
+	if (VER_UE5_PACKAGE_SAVED_HASH <= summary.file_version_ue5)
+		return std::nullopt;
+	ar.skip(sizeof(int32_t)); // FileVersionLicenseeUE4
+
+	const auto custom_version_count = ar.read<int32_t>();
+	if (custom_version_count < 0)
+		return std::nullopt;
+	for (int32_t i = 0; ar.ok && i < custom_version_count; ++i)
+	{
+		if (summary.legacy_file_version == -2) // ECustomVersionSerializationFormat::Enums
+		{
+			ar.skip(2 * sizeof(int32_t));
+		}
+		else if (summary.legacy_file_version < -5) // ECustomVersionSerializationFormat::Optimized
+		{
+			ar.skip(16 + sizeof(int32_t));
+		}
+		else // ECustomVersionSerializationFormat::Guids
+		{
+			ar.skip(16 + sizeof(int32_t));
+			ar.read_fstring();
+		}
+	}
+
+	summary.total_header_size = ar.read<int32_t>();
+	ar.read_fstring(); // FolderName
+	summary.package_flags = ar.read<uint32_t>();
+	summary.name_count = ar.read<int32_t>();
+	summary.name_offset = ar.read<int32_t>();
+
+	if (!ar.ok)
+		return std::nullopt;
+	if (summary.name_count < 0 || summary.name_offset < 0 || buffer.size() < static_cast<size_t>(summary.name_offset))
+		return std::nullopt;
+
+	// the rest of the fields depends on the exact version, which unversioned UE5 packages don't tell
+	if (summary.legacy_file_version <= -8 && summary.file_version_ue5 == 0)
+		return summary;
+	const auto ue4 = summary.file_version_ue4 != 0 ? summary.file_version_ue4 : VER_UE4_LATEST;
+	const auto ue5 = summary.file_version_ue5;
+
+	if (VER_UE5_ADD_SOFTOBJECTPATH_LIST <= ue5)
+		ar.skip(2 * sizeof(int32_t)); // SoftObjectPathsCount, SoftObjectPathsOffset
+	if (!(summary.package_flags & PKG_FilterEditorOnly) && VER_UE4_ADDED_PACKAGE_SUMMARY_LOCALIZATION_ID <= ue4)
+		ar.read_fstring(); // LocalizationId
+	if (VER_UE4_SERIALIZE_TEXT_IN_PACKAGES <= ue4)
+		ar.skip(2 * sizeof(int32_t)); // GatherableTextDataCount, GatherableTextDataOffset
+	const auto export_count = ar.read<int32_t>();
+	const auto export_offset = ar.read<int32_t>();
+	const auto import_count = ar.read<int32_t>();
+	const auto import_offset = ar.read<int32_t>();
+
+	if (!ar.ok || export_count < 0 || export_offset < 0 || import_count < 0 || import_offset < 0)
+		return summary;
+
+	summary.export_count = export_count;
+	summary.export_offset = export_offset;
+	summary.import_count = import_count;
+	summary.import_offset = import_offset;
+	return summary;
+}
+
+// Raw characters of every name map entry (ANSI or UTF-16, as serialized).
+std::optional<std::vector<byte_span>> read_name_map(byte_span buffer, FPackageFileSummary const& summary)
+{
+	auto ar = archive_reader{ buffer, static_cast<size_t>(summary.name_offset) };
+	const bool has_hashes = summary.file_version_ue4 == 0 || VER_UE4_NAME_HASHES_SERIALIZED <= summary.file_version_ue4; // unversioned packages are always recent
+
+	std::vector<byte_span> names;
+	names.reserve(std::min<size_t>(summary.name_count, buffer.size() / 4));
+	for (int32_t i = 0; i < summary.name_count; ++i)
+	{
+		names.push_back(ar.read_fstring());
+		if (has_hashes)
+			ar.skip(2 * sizeof(uint16_t)); // NonCasePreservingHash, CasePreservingHash
+		if (!ar.ok)
+			return std::nullopt;
+	}
+	return names;
+}
+
+// Classes whose exports are mostly bulk payload (mips, vertex buffers, key frames, light maps) and have no FText
+// properties. SoundWave isn't here, its subtitles are texts.
+constexpr std::array<std::string_view, 15> BULK_EXPORT_CLASSES = {
+	"Texture2D", "TextureCube", "Texture2DArray", "TextureCubeArray", "VolumeTexture", "VirtualTexture2D",
+	"LightMapTexture2D", "ShadowMapTexture2D", "LightMapVirtualTexture2D", "StaticMesh", "SkeletalMesh",
+	"AnimSequence", "MapBuildDataRegistry", "Model", "PhysicsAsset"
+};
+
+// Ranges of payload (a .uexp, or the package itself when payload_offset is 0) that hold exports which may contain
+// texts, sorted by offset. Returns nullopt if the import or export map can't be read or doesn't fit the payload.
+std::optional<std::vector<std::pair<size_t, size_t>>> read_text_export_ranges(byte_span package, FPackageFileSummary const& summary, std::vector<byte_span> const& names, size_t payload_offset, size_t payload_size)
+{
+	if (summary.export_count < 0 || summary.import_count < 0)
+		return std::nullopt;
+
+	const auto ue4 = summary.file_version_ue4 != 0 ? summary.file_version_ue4 : VER_UE4_LATEST;
+	const auto ue5 = summary.file_version_ue5;
+
+	const auto name_of = [&] (int32_t index) -> std::string_view {
+		if (index < 0 || names.size() <= static_cast<size_t>(index))
+			return {};
+		return std::string_view(reinterpret_cast<const char*>(names[index].data()), names[index].size());
+	};
+
+	auto ar = archive_reader{ package, static_cast<size_t>(summary.import_offset) };
+	std::vector<bool> bulk_imports;
+	bulk_imports.reserve(std::min<size_t>(summary.import_count, package.size() / 28));
+	for (int32_t i = 0; i < summary.import_count; ++i)
+	{
+		ar.skip(4 * sizeof(int32_t)); // ClassPackage, ClassName
+		ar.skip(sizeof(int32_t)); // OuterIndex
+		const auto object_name = ar.read<int32_t>();
+		ar.skip(sizeof(int32_t));
+		if (!(summary.package_flags & PKG_FilterEditorOnly) && VER_UE4_NON_OUTER_PACKAGE_IMPORT <= ue4)
+			ar.skip(2 * sizeof(int32_t)); // PackageName
+		if (VER_UE5_OPTIONAL_RESOURCES <= ue5)
+			ar.skip(sizeof(int32_t)); // bImportOptional
+		if (!ar.ok)
+			return std::nullopt;
+		const auto name = name_of(object_name);
+		bulk_imports.push_back(std::find(BULK_EXPORT_CLASSES.begin(), BULK_EXPORT_CLASSES.end(), name) != BULK_EXPORT_CLASSES.end());
+	}
+
+	ar = archive_reader{ package, static_cast<size_t>(summary.export_offset) };
+	std::vector<std::pair<size_t, size_t>> ranges;
+	for (int32_t i = 0; i < summary.export_count; ++i)
+	{
+		const auto class_index = ar.read<int32_t>();
+		ar.skip(sizeof(int32_t)); // SuperIndex
+		if (VER_UE4_TemplateIndex_IN_COOKED_EXPORTS <= ue4)
+			ar.skip(sizeof(int32_t)); // TemplateIndex
+		ar.skip(sizeof(int32_t)); // OuterIndex
+		ar.skip(2 * sizeof(int32_t)); // ObjectName
+		ar.skip(sizeof(uint32_t)); // ObjectFlags
+		int64_t serial_size = 0;
+		int64_t serial_offset = 0;
+		if (VER_UE4_64BIT_EXPORTMAP_SERIALSIZES <= ue4)
+		{
+			serial_size = ar.read<int64_t>();
+			serial_offset = ar.read<int64_t>();
 		}
 		else
 		{
-			if (buffer.size() < index + length)
-				return std::nullopt;
-			if (buffer[index + length - 1] != 0)
-				return std::nullopt;
-			std::wstring s;
-			for (size_t i = index; i < index + length - 1; ++i)
+			serial_size = ar.read<int32_t>();
+			serial_offset = ar.read<int32_t>();
+		}
+		ar.skip(3 * sizeof(int32_t)); // bForcedExport, bNotForClient, bNotForServer
+		if (ue5 < VER_UE5_REMOVE_OBJECT_EXPORT_PACKAGE_GUID)
+			ar.skip(16); // PackageGuid
+		if (VER_UE5_TRACK_OBJECT_EXPORT_IS_INHERITED <= ue5)
+			ar.skip(sizeof(int32_t)); // bIsInheritedInstance
+		ar.skip(sizeof(uint32_t)); // PackageFlags
+		if (VER_UE4_LOAD_FOR_EDITOR_GAME <= ue4)
+			ar.skip(sizeof(int32_t)); // bNotAlwaysLoadedForEditorGame
+		if (VER_UE4_COOKED_ASSETS_IN_EDITOR_SUPPORT <= ue4)
+			ar.skip(sizeof(int32_t)); // bIsAsset
+		if (VER_UE5_OPTIONAL_RESOURCES <= ue5)
+			ar.skip(sizeof(int32_t)); // bGeneratePublicHash
+		if (VER_UE4_PRELOAD_DEPENDENCIES_IN_COOKED_EXPORTS <= ue4)
+			ar.skip(5 * sizeof(int32_t)); // FirstExportDependency and the four dependency counts
+		if (VER_UE5_SCRIPT_SERIALIZATION_OFFSET <= ue5)
+			ar.skip(2 * sizeof(int64_t)); // ScriptSerializationStartOffset, ScriptSerializationEndOffset
+		if (!ar.ok)
+			return std::nullopt;
+
+		if (serial_size < 0 || serial_offset < static_cast<int64_t>(payload_offset))
+			return std::nullopt;
+		const auto begin = static_cast<size_t>(serial_offset) - payload_offset;
+		if (payload_size < begin || payload_size - begin < static_cast<size_t>(serial_size))
+			return std::nullopt;
+
+		if (class_index < 0 && static_cast<size_t>(-static_cast<int64_t>(class_index) - 1) < bulk_imports.size() && bulk_imports[-static_cast<int64_t>(class_index) - 1])
+			continue;
+		ranges.emplace_back(begin, begin + static_cast<size_t>(serial_size));
+	}
+
+	std::sort(ranges.begin(), ranges.end());
+	return ranges;
+}
+
+// Aho-Corasick automaton over bytes, compiled into a full transition table, so all signatures are searched for in one
+// pass with a single table lookup per byte. Every signature carries a tag bit, a scan reports the union of found tags.
+class signature_matcher
+{
+public:
+	signature_matcher()
+		: transitions(1), outputs(1, 0)
+	{
+	}
+
+	void add(std::string_view signature, uint32_t tag)
+	{
+		uint32_t state = 0;
+		for (const auto c : signature)
+		{
+			if (const auto next = transitions[state][static_cast<unsigned char>(c)]; next != 0)
 			{
-				const auto ch = buffer[i];
-				if (ch == 0)
-					return std::nullopt;
-				if (!good_ch(ch))
-					return std::nullopt;
-				s += ch;
+				state = next;
+				continue;
 			}
-			index += length;
-			return s;
+			// emplace_back() may reallocate transitions, so no reference into it is held across the call
+			const auto fresh = static_cast<uint32_t>(transitions.size());
+			transitions[state][static_cast<unsigned char>(c)] = fresh;
+			transitions.emplace_back();
+			outputs.push_back(0);
+			state = fresh;
+		}
+		outputs[state] |= tag;
+	}
+
+	// Must be called after the last add() and before the first scan().
+	void build()
+	{
+		std::vector<uint32_t> fail(transitions.size(), 0);
+		std::deque<uint32_t> queue;
+		for (auto const& next : transitions[0])
+			if (next != 0)
+				queue.push_back(next);
+		while (!queue.empty())
+		{
+			const auto state = queue.front();
+			queue.pop_front();
+			outputs[state] |= outputs[fail[state]];
+			for (size_t c = 0; c < 256; ++c)
+			{
+				auto & next = transitions[state][c];
+				if (next == 0)
+				{
+					next = transitions[fail[state]][c];
+					continue;
+				}
+				fail[next] = transitions[fail[state]][c];
+				queue.push_back(next);
+			}
+		}
+	}
+
+	// Returns the tags of all signatures occurring in data, stops early once every tag of `wanted` was seen.
+	uint32_t scan(byte_span data, uint32_t wanted) const
+	{
+		uint32_t found = 0;
+		uint32_t state = 0;
+		for (const auto b : data)
+		{
+			state = transitions[state][static_cast<unsigned char>(b)];
+			found |= outputs[state];
+			if ((found & wanted) == wanted)
+				break;
 		}
-	};
-
-	const auto ns = read_string();
-	if (!ns.has_value())
-		return std::nullopt;
-	if (128 < ns->size())    // static const int32 InlineStringSize = 128;
-		return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
+		if (data.empty())
+			return 0;
+		return found | outputs[0]; // empty signatures match any non-empty data
+	}
 
-	if (buffer.size() < index + 8)
-		return std::nullopt;
+private:
+	std::vector<std::array<uint32_t, 256>> transitions;
+	std::vector<uint32_t> outputs;
+};
 
-	const auto size = *reinterpret_cast<const int*>(buffer.data() + index);
-	index += 4;
-	if (size < 1)
-		return std::nullopt;
+constexpr uint32_t BLUEPRINT_TAG = 1 << 0;
+constexpr uint32_t TEXT_PROPERTY_TAG = 1 << 1;
+constexpr uint32_t STRING_TABLE_TAG = 1 << 2;
+constexpr uint32_t RAW_TEXT_TAG = 1 << 3;
 
-	std::vector<FText> table;
+constexpr size_t MAX_JOBS = 256; // more threads only cost arenas and scheduling
 
-	// size maybe very large
-	//table.reserve(size);
+struct extract_settings
+{
+	std::vector<std::string> raw_text_signatures;
+	bool all_uexps = false;
+	bool full_scan = false;
+	size_t jobs = 1;
 
-	int good_score = 0;
+	signature_matcher signatures;
 
-	for (size_t i = 0; i < size; ++i)
+	void build_signatures()
 	{
-		const auto key = read_string();
-		if (!key.has_value())
-			return std::nullopt;
-		if (key->size() == 0)
-			return std::nullopt;
-		if (128 < key->size())   // static const int32 InlineStringSize = 128;
-			return std::nullopt; // UE_CLOG(SaveNum > InlineStringSize, LogTextKey, VeryVerbose, TEXT("Key string '%s' was larger (%d) than the inline size (%d) and caused an allocation!"), OutStrBuffer.GetData(), SaveNum, InlineStringSize);
-		const auto s = read_string();
-		if (!s.has_value())
-			return std::nullopt;
-		if (s->size() == 0)
-		{
-			good_score -= 2;
-			continue;
-		}
-		if (all_white_spaces(s.value()))
-		{
-			good_score -= 1;
-			continue;
-		}
-		table.push_back(FText{ ns.value(), key.value(), s.value() });
-		good_score += 2;
+		signatures.add("Blueprint", BLUEPRINT_TAG);
+		signatures.add("TextProperty", TEXT_PROPERTY_TAG);
+		signatures.add("StringTable", STRING_TABLE_TAG);
+		if (!all_raw_texts())
+			for (auto const& raw_text_signature : raw_text_signatures)
+				signatures.add(raw_text_signature, RAW_TEXT_TAG);
+		signatures.build();
 	}
 
-	if (good_score < 0)
-		return std::nullopt;
-
-	if (buffer.size() < index + 4)
-		return std::nullopt;
+	bool all_raw_texts() const
+	{
+		return raw_text_signatures.size() == 1 && raw_text_signatures.back() == "all";
+	}
+};
 
-	const auto metadata_size = *reinterpret_cast<const int*>(buffer.data() + index);
-	index += 4;
-	if (metadata_size < 0)
-		return std::nullopt;
+// path::wstring() converts with the classic "C" codecvt on POSIX and throws on any non-ASCII name, while the UTF-32
+// conversion always decodes UTF-8.
+std::wstring path_to_wstring(std::filesystem::path const& path)
+{
+#ifdef _WIN32
+	return path.wstring();
+#else
+	const auto utf32 = path.u32string();
+	return std::wstring(utf32.begin(), utf32.end());
+#endif
+}
 
-	return std::pair{ std::move(table), index };
+bool is_extractable(std::filesystem::path const& file, extract_settings const& settings)
+{
+	return file.extension() == L".uasset" || file.extension() == L".umap" || (settings.all_uexps && file.extension() == L".uexp");
 }
 
-void file_extract(std::filesystem::path root, std::filesystem::path file, std::vector<std::string> const& raw_text_signatures, bool all_uexps, std::vector<FText> & texts)
+// Large buffers are scanned in chunks by the free threads of threads.
+void file_extract(std::filesystem::path root, std::filesystem::path file, extract_settings const& settings, thread_budget & threads, string_pool & pool, text_arena & arena, scan_counters & counters, std::vector<FText> & texts)
 {
-	if (!(file.extension() == L".uasset" || file.extension() == L".umap" || all_uexps && file.extension() == L".uexp"))
+	if (!is_extractable(file, settings))
 		return;
 
 	const auto replace_extension = [&] (std::filesystem::path const& ext) {
@@ -477,52 +1767,61 @@ void file_extract(std::filesystem::path root, std::filesystem::path file, std::v
 			return;
 	}
 
-	std::wstring src = std::filesystem::relative(file, root);
+	auto src = std::filesystem::relative(file, root);
 
-	std::wcout << src << std::endl;
+	{
+		static std::mutex console_mutex;
+		const auto lock = std::lock_guard{ console_mutex };
+		std::wcout << path_to_wstring(src) << std::endl;
+	}
 
-	auto fin = std::ifstream{ file, std::ios::binary | std::ios::ate };
-	if (fin.fail())
+	mapped_file asset;
+	if (!asset.open(file))
 		return;
 
-	auto buffer = std::vector<char>(fin.tellg());
-	fin.seekg(0, std::ios::beg);
-	fin.read(buffer.data(), buffer.size());
+	auto buffer = asset.bytes();
+
+	mapped_file uexp;
+	std::optional<std::vector<byte_span>> names;
+	std::optional<std::vector<std::pair<size_t, size_t>>> ranges;
 
 	bool has_blueprint = false;
 	bool has_text_property = false;
 	bool has_string_table = false;
 	bool has_very_good_raw_text = false;
 
-	if (raw_text_signatures.size() == 1 && raw_text_signatures.back() == "all")
+	if (settings.all_raw_texts())
 		has_very_good_raw_text = true;
 
 	if (file.extension() == L".uasset" || file.extension() == L".umap")
 	{
-		constexpr std::string_view BLUEPRINT_SIGNATURE = "Blueprint";
-		constexpr std::string_view TEXT_PROPERTY_SIGNATURE = "TextProperty";
-		constexpr std::string_view STRING_TABLE_SIGNATURE = "StringTable";
-
-		for (size_t i = 0; i < buffer.size(); ++i)
-		{
-			if (!has_blueprint && test_signature(BLUEPRINT_SIGNATURE, buffer, i))
-				has_blueprint = true;
-			if (!has_text_property && test_signature(TEXT_PROPERTY_SIGNATURE, buffer, i))
-				has_text_property = true;
-			if (!has_string_table && test_signature(STRING_TABLE_SIGNATURE, buffer, i))
-				has_string_table = true;
-			if (0 < raw_text_signatures.size() && !has_very_good_raw_text)
+		uint32_t wanted = BLUEPRINT_TAG | TEXT_PROPERTY_TAG | STRING_TABLE_TAG;
+		if (0 < settings.raw_text_signatures.size() && !has_very_good_raw_text)
+			wanted |= RAW_TEXT_TAG;
+
+		// Class and property type names all live in the name map, so a readable header spares scanning the whole file.
+		const auto summary = read_package_summary(buffer);
+		if (summary.has_value())
+			names = read_name_map(buffer, summary.value());
+		const auto found = [&] () {
+			if (names.has_value())
 			{
-				for (auto const& raw_text_signature : raw_text_signatures)
-					if (test_signature(raw_text_signature, buffer, i))
-					{
-						has_very_good_raw_text = true;
+				uint32_t found = 0;
+				for (auto const& name : names.value())
+				{
+					found |= settings.signatures.scan(name, wanted & ~found);
+					if ((found & wanted) == wanted)
 						break;
-					}
+				}
+				return found;
 			}
-			if (has_blueprint && has_text_property && has_string_table && (raw_text_signatures.size() == 0 || has_very_good_raw_text))
-				break;
-		}
+			return settings.signatures.scan(buffer, wanted);
+		}();
+		has_blueprint = found & BLUEPRINT_TAG;
+		has_text_property = found & TEXT_PROPERTY_TAG;
+		has_string_table = found & STRING_TABLE_TAG;
+		if (found & RAW_TEXT_TAG)
+			has_very_good_raw_text = true;
 
 		if (!(has_blueprint || has_text_property || has_string_table || has_very_good_raw_text))
 			return;
@@ -531,12 +1830,17 @@ void file_extract(std::filesystem::path root, std::filesystem::path file, std::v
 		{
 			src = std::filesystem::relative(uexp_file, root);
 
-			fin = std::ifstream{ uexp_file, std::ios::binary | std::ios::ate };
-			if (fin.fail())
+			if (!uexp.open(uexp_file))
 				return;
-			buffer = std::vector<char>(fin.tellg());
-			fin.seekg(0, std::ios::beg);
-			fin.read(buffer.data(), buffer.size());
+			if (!settings.full_scan && names.has_value())
+				ranges = read_text_export_ranges(buffer, summary.value(), names.value(), summary->total_header_size, uexp.bytes().size());
+			names.reset();
+			asset.close();
+			buffer = uexp.bytes();
+		}
+		else if (!settings.full_scan && names.has_value())
+		{
+			ranges = read_text_export_ranges(buffer, summary.value(), names.value(), 0, buffer.size());
 		}
 	}
 	else
@@ -544,67 +1848,83 @@ void file_extract(std::filesystem::path root, std::filesystem::path file, std::v
 		has_blueprint = true;
 		has_text_property = true;
 		has_string_table = true;
-		if (0 < raw_text_signatures.size())
+		if (0 < settings.raw_text_signatures.size())
 			has_very_good_raw_text = true;
 	}
 
-	for (size_t i = 0; i < buffer.size(); ++i)
+	const auto detectors = text_detectors{ has_blueprint, has_text_property, has_string_table, has_very_good_raw_text };
+	const auto first_text = texts.size();
+	if (ranges.has_value())
 	{
-		if (has_blueprint)
-		{
-			if (const auto text = try_read_blueprint_text(buffer, i); text.has_value())
-			{
-				texts.push_back(text.value().first);
-				texts.back().src = src;
-				i = text.value().second - 1;
-				continue;
-			}
-		}
-		if (has_text_property)
-		{
-			if (const auto text = try_read_ftext(buffer, i); text.has_value())
-			{
-				texts.push_back(text.value().first);
-				texts.back().src = src;
-				i = text.value().second - 1;
-				continue;
-			}
-		}
-		if (has_string_table)
-		{
-			if (const auto table = try_read_string_table(buffer, i); table.has_value())
-			{
-				for (auto const& text : table.value().first)
-				{
-					texts.push_back(text);
-					texts.back().src = src;
-				}
-				i = table.value().second - 1;
-				continue;
-			}
-		}
-		if (has_very_good_raw_text)
-		{
-			if (const auto text = try_read_very_good_raw_text(buffer, i); text.has_value())
-			{
-				texts.push_back(text.value().first);
-				texts.back().src = src;
-				i = text.value().second - 1;
-				continue;
-			}
-		}
+		size_t index = 0;
+		for (auto const& range : ranges.value())
+			index = scan_buffer(buffer, std::max(index, range.first), range.second, detectors, threads, pool, arena, counters, texts);
 	}
+	else
+	{
+		scan_buffer(buffer, 0, buffer.size(), detectors, threads, pool, arena, counters, texts);
+	}
+	const auto src_id = pool.intern(src.u16string());
+	for (size_t i = first_text; i < texts.size(); ++i)
+		texts[i].src = src_id;
 }
 
-void directory_extract(std::filesystem::path root, std::filesystem::path directory, std::vector<std::string> const& raw_text_signatures, bool all_uexps, std::vector<FText> & texts)
+void collect_files(std::filesystem::path directory, std::vector<std::filesystem::path> & files)
 {
 	for (auto const& entry : std::filesystem::directory_iterator(directory))
 	{
 		if (entry.is_directory())
-			directory_extract(root, entry, raw_text_signatures, all_uexps, texts);
+			collect_files(entry, files);
 		else
-			file_extract(root, entry, raw_text_signatures, all_uexps, texts);
+			files.push_back(entry);
+	}
+}
+
+// arenas must hold one arena per job, texts found by a worker go into its own arena.
+void directory_extract(std::filesystem::path root, extract_settings const& settings, string_pool & pool, std::vector<text_arena> & arenas, scan_counters & counters, std::vector<FText> & texts)
+{
+	std::vector<std::filesystem::path> files;
+	collect_files(root, files);
+
+	if (settings.jobs <= 1)
+	{
+		auto threads = thread_budget{ 1, 0 };
+		for (auto const& file : files)
+			file_extract(root, file, settings, threads, pool, arenas.front(), counters, texts);
+		return;
+	}
+
+	std::vector<uintmax_t> weights;
+	weights.reserve(files.size());
+	for (auto const& file : files)
+	{
+		std::error_code ec;
+		auto weight = std::filesystem::file_size(file, ec);
+		if (ec)
+			weight = 0;
+		if (file.extension() == L".uasset" || file.extension() == L".umap")
+		{
+			auto uexp_file = file;
+			if (const auto uexp_size = std::filesystem::file_size(uexp_file.replace_extension(L".uexp"), ec); !ec)
+				weight += uexp_size;
+		}
+		weights.push_back(weight);
 	}
+
+	// every file gets its own result slot, so merging them in enumeration order reproduces the sequential output
+	auto results = std::vector<std::vector<FText>>(files.size());
+	auto results_counters = std::vector<scan_counters>(files.size());
+	// No thread is free while every worker has files left. Workers that run out of them join the chunked scans of the
+	// large files still running, so -j stays the cap on the number of threads.
+	auto threads = thread_budget{ settings.jobs, 0 };
+	run_work_stealing(weights, settings.jobs, [&] (size_t i, size_t worker) {
+		file_extract(root, files[i], settings, threads, pool, arenas[worker], results_counters[i], results[i]);
+	}, &threads);
+
+	for (auto & result : results)
+		std::move(result.begin(), result.end(), std::back_inserter(texts));
+	for (auto const& result_counters : results_counters)
+		counters += result_counters;
 }
 
 namespace crc32
@@ -628,80 +1948,318 @@ namespace crc32
 		0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 	};
 
-	unsigned int StrCrc32_Unicode(std::wstring string)
+	// CRCTablesSB16[k][b] advances the CRC over byte b followed by k zero bytes, so 16 bytes fold in one step.
+	constexpr auto CRCTablesSB16 = [] ()
+	{
+		std::array<std::array<uint32_t, 256>, 16> tables{};
+		for (size_t b = 0; b < 256; ++b)
+			tables[0][b] = CRCTablesSB8[b];
+		for (size_t k = 1; k < tables.size(); ++k)
+			for (size_t b = 0; b < 256; ++b)
+				tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xFF];
+		return tables;
+	}();
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(__GNUC__)
+#define PCLMUL_TARGET __attribute__((target("pclmul")))
+#else
+#define PCLMUL_TARGET
+#endif
+
+	// Strings shorter than this are cheaper on the tables than through the folding setup and final reduction.
+	constexpr size_t PCLMUL_MIN_LENGTH = 32;
+
+	bool has_pclmul()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 1)) != 0;
+#else
+		return __builtin_cpu_supports("pclmul");
+#endif
+	}
+
+	// Four characters widened to the four 32-bit little-endian units StrCrc32 hashes them as.
+	PCLMUL_TARGET inline __m128i load_units(const char16_t* data)
 	{
-		std::vector<unsigned int> buf;
-		for (size_t i = 0; i < string.size(); ++i)
+		return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)), _mm_setzero_si128());
+	}
+
+	PCLMUL_TARGET inline __m128i fold(__m128i x, __m128i k, __m128i next)
+	{
+		return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+	}
+
+	// Carry-less multiplication folding of the widened string, 16 characters per step, followed by a Barrett reduction
+	// (constants from Intel's "Fast CRC Computation Using PCLMULQDQ"). Takes the running CRC and at least 16
+	// characters, consumes a multiple of 4 of them and reports how many in done.
+	PCLMUL_TARGET uint32_t update_pclmul(uint32_t crc, std::u16string_view string, size_t & done)
+	{
+		const auto data = string.data();
+		auto x1 = _mm_xor_si128(load_units(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+		auto x2 = load_units(data + 4);
+		auto x3 = load_units(data + 8);
+		auto x4 = load_units(data + 12);
+		size_t i = 16;
+		const auto r2r1 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+		for (; i + 16 <= string.size(); i += 16)
+		{
+			x1 = fold(x1, r2r1, load_units(data + i));
+			x2 = fold(x2, r2r1, load_units(data + i + 4));
+			x3 = fold(x3, r2r1, load_units(data + i + 8));
+			x4 = fold(x4, r2r1, load_units(data + i + 12));
+		}
+		const auto r4r3 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+		x1 = fold(x1, r4r3, x2);
+		x1 = fold(x1, r4r3, x3);
+		x1 = fold(x1, r4r3, x4);
+		for (; i + 4 <= string.size(); i += 4)
+			x1 = fold(x1, r4r3, load_units(data + i));
+		done = i;
+
+		// 128 to 64 bits, then 64 to 32 bits.
+		const auto mask32 = _mm_setr_epi32(-1, 0, 0, 0);
+		x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, r4r3, 0x10), _mm_srli_si128(x1, 8));
+		x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), _mm_set_epi64x(0, 0x163cd6124), 0x00), _mm_srli_si128(x1, 4));
+
+		const auto poly = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+		auto t = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+		t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(_mm_xor_si128(t, x1), 4)));
+	}
+#endif
+
+	// UE hashes every character as a 32-bit little-endian unit whatever its range, so only the two low bytes of each
+	// unit need a table lookup: the zero high bytes contribute nothing. Continues the running CRC from character i on,
+	// this is all StrCrc32 runs on CPUs without PCLMULQDQ.
+	uint32_t update_tables(uint32_t crc, std::u16string_view string, size_t i)
+	{
+		const auto & t = CRCTablesSB16;
+		for (; i + 4 <= string.size(); i += 4)
 		{
-			buf.push_back(string[i] & 0xFF);
-			buf.push_back((string[i] & 0xFF00) >> 8);
+			const uint32_t c0 = crc ^ string[i];
+			const uint32_t c1 = string[i + 1], c2 = string[i + 2], c3 = string[i + 3];
+			crc = t[15][c0 & 0xFF] ^ t[14][(c0 >> 8) & 0xFF] ^ t[13][(c0 >> 16) & 0xFF] ^ t[12][c0 >> 24]
+				^ t[11][c1 & 0xFF] ^ t[10][c1 >> 8]
+				^ t[7][c2 & 0xFF] ^ t[6][c2 >> 8]
+				^ t[3][c3 & 0xFF] ^ t[2][c3 >> 8];
 		}
-		auto CRC = 0xFFFFFFFF;
-		for (size_t i = 0; i < buf.size() / 2; ++i)
+		for (; i < string.size(); ++i)
 		{
-			CRC = (CRC >> 8) ^ CRCTablesSB8[(CRC ^ buf[i * 2 + 0]) & 0xFF];
-			CRC = (CRC >> 8) ^ CRCTablesSB8[(CRC ^ buf[i * 2 + 1]) & 0xFF];
-			CRC = (CRC >> 8) ^ CRCTablesSB8[CRC & 0xFF];
-			CRC = (CRC >> 8) ^ CRCTablesSB8[CRC & 0xFF];
+			crc ^= string[i];
+			crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF] ^ t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24];
 		}
-		return CRC ^ 0xFFFFFFFF;
+		return crc;
+	}
+
+	uint32_t StrCrc32(std::u16string_view string)
+	{
+		uint32_t crc = 0xFFFFFFFF;
+		size_t i = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+		static const bool pclmul = has_pclmul();
+		if (pclmul && PCLMUL_MIN_LENGTH <= string.size())
+			crc = update_pclmul(crc, string, i);
+#endif
+		return ~update_tables(crc, string, i);
+	}
+}
+
+// CityHash64 1.1, which UE uses for the key hashes of version 3 locres files.
+namespace cityhash
+{
+	constexpr uint64_t k0 = 0xc3a5c85c97cb3127;
+	constexpr uint64_t k1 = 0xb492b66fbe98f273;
+	constexpr uint64_t k2 = 0x9ae16a3b2f90404f;
+
+	inline uint64_t Fetch64(const char* p)
+	{
+		uint64_t result;
+		std::memcpy(&result, p, sizeof(result));
+		return result;
+	}
+
+	inline uint32_t Fetch32(const char* p)
+	{
+		uint32_t result;
+		std::memcpy(&result, p, sizeof(result));
+		return result;
+	}
+
+	inline uint64_t Bswap64(uint64_t x)
+	{
+		return ((x & 0x00000000000000FF) << 56) | ((x & 0x000000000000FF00) << 40) | ((x & 0x0000000000FF0000) << 24) | ((x & 0x00000000FF000000) << 8)
+			| ((x & 0x000000FF00000000) >> 8) | ((x & 0x0000FF0000000000) >> 24) | ((x & 0x00FF000000000000) >> 40) | ((x & 0xFF00000000000000) >> 56);
+	}
+
+	inline uint64_t Rotate(uint64_t val, int shift)
+	{
+		return std::rotr(val, shift);
+	}
+
+	inline uint64_t ShiftMix(uint64_t val)
+	{
+		return val ^ (val >> 47);
 	}
 
-	unsigned int StrCrc32_ASCII(std::wstring string)
+	inline uint64_t HashLen16(uint64_t u, uint64_t v, uint64_t mul = 0x9ddfea08eb382d69)
 	{
-		std::vector<unsigned int> buf;
-		for (size_t i = 0; i < string.size(); ++i)
-			buf.push_back(string[i]);
-		auto CRC = 0xFFFFFFFF;
-		for (size_t i = 0; i < buf.size(); ++i)
+		auto a = (u ^ v) * mul;
+		a ^= (a >> 47);
+		auto b = (v ^ a) * mul;
+		b ^= (b >> 47);
+		b *= mul;
+		return b;
+	}
+
+	inline uint64_t HashLen0to16(const char* s, size_t len)
+	{
+		if (len >= 8)
+		{
+			const uint64_t mul = k2 + len * 2;
+			const uint64_t a = Fetch64(s) + k2;
+			const uint64_t b = Fetch64(s + len - 8);
+			const uint64_t c = Rotate(b, 37) * mul + a;
+			const uint64_t d = (Rotate(a, 25) + b) * mul;
+			return HashLen16(c, d, mul);
+		}
+		if (len >= 4)
+		{
+			const uint64_t mul = k2 + len * 2;
+			const uint64_t a = Fetch32(s);
+			return HashLen16(len + (a << 3), Fetch32(s + len - 4), mul);
+		}
+		if (len > 0)
 		{
-			CRC = (CRC >> 8) ^ CRCTablesSB8[(CRC ^ buf[i]) & 0xFF];
-			CRC = (CRC >> 8) ^ CRCTablesSB8[CRC & 0xFF];
-			CRC = (CRC >> 8) ^ CRCTablesSB8[CRC & 0xFF];
-			CRC = (CRC >> 8) ^ CRCTablesSB8[CRC & 0xFF];
+			const uint8_t a = s[0];
+			const uint8_t b = s[len >> 1];
+			const uint8_t c = s[len - 1];
+			const uint32_t y = static_cast<uint32_t>(a) + (static_cast<uint32_t>(b) << 8);
+			const uint32_t z = static_cast<uint32_t>(len) + (static_cast<uint32_t>(c) << 2);
+			return ShiftMix(y * k2 ^ z * k0) * k2;
 		}
-		return CRC ^ 0xFFFFFFFF;
+		return k2;
+	}
+
+	inline uint64_t HashLen17to32(const char* s, size_t len)
+	{
+		const uint64_t mul = k2 + len * 2;
+		const uint64_t a = Fetch64(s) * k1;
+		const uint64_t b = Fetch64(s + 8);
+		const uint64_t c = Fetch64(s + len - 8) * mul;
+		const uint64_t d = Fetch64(s + len - 16) * k2;
+		return HashLen16(Rotate(a + b, 43) + Rotate(c, 30) + d, a + Rotate(b + k2, 18) + c, mul);
+	}
+
+	inline std::pair<uint64_t, uint64_t> WeakHashLen32WithSeeds(const char* s, uint64_t a, uint64_t b)
+	{
+		const uint64_t w = Fetch64(s);
+		const uint64_t x = Fetch64(s + 8);
+		const uint64_t y = Fetch64(s + 16);
+		const uint64_t z = Fetch64(s + 24);
+		a += w;
+		b = Rotate(b + a + z, 21);
+		const uint64_t c = a;
+		a += x;
+		a += y;
+		b += Rotate(a, 44);
+		return { a + z, b + c };
+	}
+
+	inline uint64_t HashLen33to64(const char* s, size_t len)
+	{
+		const uint64_t mul = k2 + len * 2;
+		uint64_t a = Fetch64(s) * k2;
+		uint64_t b = Fetch64(s + 8);
+		const uint64_t c = Fetch64(s + len - 24);
+		const uint64_t d = Fetch64(s + len - 32);
+		const uint64_t e = Fetch64(s + 16) * k2;
+		const uint64_t f = Fetch64(s + 24) * 9;
+		const uint64_t g = Fetch64(s + len - 8);
+		const uint64_t h = Fetch64(s + len - 16) * mul;
+		const uint64_t u = Rotate(a + g, 43) + (Rotate(b, 30) + c) * 9;
+		const uint64_t v = ((a + g) ^ d) + f + 1;
+		const uint64_t w = Bswap64((u + v) * mul) + h;
+		const uint64_t x = Rotate(e + f, 42) + c;
+		const uint64_t y = (Bswap64((v + w) * mul) + g) * mul;
+		const uint64_t z = e + f + c;
+		a = Bswap64((x + z) * mul + y) + b;
+		b = ShiftMix((z + a) * mul + d + h) * mul;
+		return b + x;
 	}
 
-	unsigned int StrCrc32(std::wstring string)
+	uint64_t CityHash64(const char* s, size_t len)
 	{
-		bool bNeedUnicode = false;
-		for (size_t i = 0; i < string.size(); ++i)
+		if (len <= 16)
+			return HashLen0to16(s, len);
+		if (len <= 32)
+			return HashLen17to32(s, len);
+		if (len <= 64)
+			return HashLen33to64(s, len);
+
+		uint64_t x = Fetch64(s + len - 40);
+		uint64_t y = Fetch64(s + len - 16) + Fetch64(s + len - 56);
+		uint64_t z = HashLen16(Fetch64(s + len - 48) + len, Fetch64(s + len - 24));
+		auto v = WeakHashLen32WithSeeds(s + len - 64, len, z);
+		auto w = WeakHashLen32WithSeeds(s + len - 32, y + k1, x);
+		x = x * k1 + Fetch64(s);
+
+		len = (len - 1) & ~static_cast<size_t>(63);
+		do
 		{
-			if (!(0x0000 <= string[i] && string[i] <= 0x00FF))
-			{
-				bNeedUnicode = true;
-				break;
-			}
+			x = Rotate(x + y + v.first + Fetch64(s + 8), 37) * k1;
+			y = Rotate(y + v.second + Fetch64(s + 48), 42) * k1;
+			x ^= w.second;
+			y += v.first + Fetch64(s + 40);
+			z = Rotate(z + w.first, 33) * k1;
+			v = WeakHashLen32WithSeeds(s, v.second * k1, x + w.first);
+			w = WeakHashLen32WithSeeds(s + 32, z + w.second, y + Fetch64(s + 16));
+			std::swap(z, x);
+			s += 64;
+			len -= 64;
 		}
-		if (bNeedUnicode)
-			return StrCrc32_Unicode(string);
-		else
-			return StrCrc32_ASCII(string);
+		while (len != 0);
+		return HashLen16(HashLen16(v.first, w.first) + ShiftMix(y) * k1 + z, HashLen16(v.second, w.second) + x);
 	}
 }
 
+// Namespace and key hash stored in front of the strings by locres version 2 (StrCrc32) and version 3 (CityHash64 of the
+// UTF-16 string, folded to 32 bits the way GetTypeHash folds 64-bit values).
+uint32_t locres_key_hash(uint8_t version, std::u16string_view s)
+{
+	if (version == 2)
+		return crc32::StrCrc32(s);
+	const auto hash = cityhash::CityHash64(reinterpret_cast<const char*>(s.data()), s.size() * sizeof(char16_t));
+	return static_cast<uint32_t>(hash) + static_cast<uint32_t>(hash >> 32) * 23;
+}
+
 void print_help()
 {
 	std::wcout
 		<< L"Extract localizable texts to locres or txt file:" << std::endl
-		<< L"UE4TextExtractor.exe <path to folder with extracted from pak files> <path to texts.locres file> [-old] [-raw-text-signatures=<signature1>,<signature2>,...] [-all-uexps]" << std::endl
-		<< L"UE4TextExtractor.exe <path to folder with extracted from pak files> <path to texts.txt file> [-raw-text-signatures=<signature1>,<signature2>,...] [-all-uexps] [-src]" << std::endl
+		<< L"UE4TextExtractor.exe <path to folder with extracted from pak files> <path to texts.locres file> [-old] [-locres-version=<N>] [-raw-text-signatures=<signature1>,<signature2>,...] [-all-uexps] [-full-scan] [-j <N>] [-stats]" << std::endl
+		<< L"UE4TextExtractor.exe <path to folder with extracted from pak files> <path to texts.txt file> [-raw-text-signatures=<signature1>,<signature2>,...] [-all-uexps] [-full-scan] [-src] [-j <N>] [-stats]" << std::endl
 		<< LR"(Example: UE4TextExtractor.exe "C:\MyGame\Content\Paks\unpacked" "C:\MyGame\Content\Paks\texts.locres")" << std::endl
 		<< std::endl
 
 		<< L"Use -raw-text-signatures=<signature1>,<signature2>,... (or -raw-text-signatures=all if you don't want to go into detail, but it's not recommended) modifier for parsing localizable text by custom signatures. See also: https://github.com/VD42/UE4TextExtractor/blob/master/RAW_TEXT_SIGNATURES.md." << std::endl
 		<< L"Use -all-uexps modifier for additionaly parsing uexp files without matching uasset or umap files." << std::endl
 		<< L"Use -src modifier to add string source information (filenames) to the txt file." << std::endl
+		<< L"Use -j <N> modifier to extract with N threads (0 means one thread per CPU core, values above 256 are clamped to 256)." << std::endl
+		<< L"Use -full-scan modifier to scan whole files, including exports of texture, mesh and other bulk data classes." << std::endl
+		<< L"Use -stats modifier to print scan statistics." << std::endl
 		<< std::endl
 
 		<< L"Convert locres to txt or backward:" << std::endl
-		<< L"UE4TextExtractor.exe <path to texts.txt file> <path to texts.locres file> [-old]" << std::endl
+		<< L"UE4TextExtractor.exe <path to texts.txt file> <path to texts.locres file> [-old] [-locres-version=<N>]" << std::endl
 		<< L"UE4TextExtractor.exe <path to texts.locres file> <path to texts.txt file>" << std::endl
 		<< LR"(Example: UE4TextExtractor.exe "C:\MyGame\Content\Paks\texts.txt" "C:\MyGame\Content\Paks\texts.locres")" << std::endl
 		<< std::endl
 
 		<< L"Use -old modifier for old-version locres file generation." << std::endl
+		<< L"Use -locres-version=<N> modifier to choose the locres format version: 0 is the same as -old, 1 is the default, 2 and 3 add key hashes (CRC32 and CityHash64) that newer engines use when loading." << std::endl
 		<< std::endl
 
 		<< L"Add or replace all texts from one txt to another:" << std::endl
@@ -711,247 +2269,825 @@ void print_help()
 	;
 }
 
-std::wstring replace_all(std::wstring s, std::wstring const& from, std::wstring const& to)
+// Characters that would break the txt markup in namespaces and keys, with the sequences they are written as.
+constexpr std::array<std::pair<char16_t, std::u16string_view>, 6> KEY_ESCAPES = { {
+	{ u'\r', u"&#x000013;" },
+	{ u'\n', u"&#x000010;" },
+	{ u'[', u"&#x000091;" },
+	{ u']', u"&#x000093;" },
+	{ u'{', u"&#x000123;" },
+	{ u'}', u"&#x000125;" },
+} };
+
+// Escape sequence of every ASCII character, empty for the ones written as they are.
+constexpr auto KEY_ESCAPE_TABLE = [] ()
+{
+	std::array<std::u16string_view, 128> table{};
+	for (auto const& [c, escaped] : KEY_ESCAPES)
+		table[c] = escaped;
+	return table;
+}();
+
+// Both return key itself when there is nothing to replace, otherwise the result is built in scratch in a single pass.
+std::u16string_view escape_key(std::u16string_view key, std::u16string & scratch)
+{
+	const auto needs_escape = [] (char16_t c) {
+		return c < KEY_ESCAPE_TABLE.size() && !KEY_ESCAPE_TABLE[c].empty();
+	};
+	const auto first = std::find_if(key.begin(), key.end(), needs_escape);
+	if (first == key.end())
+		return key;
+	scratch.assign(key.begin(), first);
+	for (auto it = first; it != key.end(); ++it)
+	{
+		if (needs_escape(*it))
+			scratch += KEY_ESCAPE_TABLE[*it];
+		else
+			scratch += *it;
+	}
+	return scratch;
+}
+
+std::u16string_view unescape_key(std::u16string_view key, std::u16string & scratch)
+{
+	size_t copied = 0;
+	for (auto i = key.find(u'&'); i != std::u16string_view::npos; i = key.find(u'&', i))
+	{
+		// sequences only start with '&', so they can't overlap
+		const auto escape = std::find_if(KEY_ESCAPES.begin(), KEY_ESCAPES.end(), [&] (auto const& escape) {
+			return key.substr(i).starts_with(escape.second);
+		});
+		if (escape == KEY_ESCAPES.end())
+		{
+			++i;
+			continue;
+		}
+		if (copied == 0)
+			scratch.clear();
+		scratch.append(key.substr(copied, i - copied));
+		scratch += escape->first;
+		i += escape->second.length();
+		copied = i;
+	}
+	if (copied == 0)
+		return key;
+	scratch.append(key.substr(copied));
+	return scratch;
+}
+
+struct FEntry
+{
+	text_key key;
+	uint32_t hash;
+	std::u16string_view s; // stored in a text_arena
+
+	std::u16string_view src;
+};
+
+using locres_vector = std::vector<std::pair<std::u16string_view, std::vector<FEntry>>>;
+
+// Malformed sequences turn into U+FFFD.
+void append_utf16(std::u16string & result, std::string_view s)
+{
+	for (size_t i = 0; i < s.size(); )
+	{
+		const auto lead = static_cast<unsigned char>(s[i]);
+		if (lead < 0x80)
+		{
+			result += static_cast<char16_t>(lead);
+			++i;
+			continue;
+		}
+		size_t length = 0;
+		char32_t c = 0;
+		char32_t min = 0;
+		if ((lead & 0xE0) == 0xC0)
+		{
+			length = 2;
+			c = lead & 0x1F;
+			min = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			length = 3;
+			c = lead & 0x0F;
+			min = 0x800;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			length = 4;
+			c = lead & 0x07;
+			min = 0x10000;
+		}
+		bool ok = length != 0 && i + length <= s.size();
+		for (size_t j = 1; ok && j < length; ++j)
+		{
+			const auto next = static_cast<unsigned char>(s[i + j]);
+			ok = (next & 0xC0) == 0x80;
+			c = c << 6 | (next & 0x3F);
+		}
+		if (!ok || c < min || 0x10FFFF < c || (0xD800 <= c && c <= 0xDFFF))
+		{
+			result += u'\xFFFD';
+			++i;
+			continue;
+		}
+		if (c < 0x10000)
+		{
+			result += static_cast<char16_t>(c);
+		}
+		else
+		{
+			result += static_cast<char16_t>(0xD800 + ((c - 0x10000) >> 10));
+			result += static_cast<char16_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+		}
+		i += length;
+	}
+}
+
+// Number of leading code units of s below 0x80.
+size_t ascii_run(std::u16string_view s)
+{
+	size_t i = 0;
+#if defined(_M_X64) || defined(__SSE2__)
+	for (; i + 8 <= s.size(); i += 8)
+	{
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+		const auto ascii = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xFF80))), _mm_setzero_si128());
+		const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(ascii));
+		if (mask != 0xFFFF)
+			return i + std::countr_zero(~mask) / 2;
+	}
+#endif
+	while (i < s.size() && s[i] < 0x80)
+		++i;
+	return i;
+}
+
+// Unpaired surrogates turn into U+FFFD. ASCII runs, most of any txt file, are narrowed in bulk.
+void append_utf8(std::string & result, std::u16string_view s)
 {
-	size_t pos = 0;
-	while ((pos = s.find(from, pos)) != std::wstring::npos)
+	for (size_t i = 0; i < s.size(); ++i)
 	{
-		s.replace(pos, from.length(), to);
-		pos += from.length();
+		if (s[i] < 0x80)
+		{
+			const auto run = ascii_run(s.substr(i));
+			const auto offset = result.size();
+			result.resize(offset + run);
+			const auto out = result.data() + offset;
+			size_t j = 0;
+#if defined(_M_X64) || defined(__SSE2__)
+			for (; j + 8 <= run; j += 8)
+			{
+				const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i + j));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + j), _mm_packus_epi16(v, v));
+			}
+#endif
+			for (; j < run; ++j)
+				out[j] = static_cast<char>(s[i + j]);
+			i += run - 1;
+			continue;
+		}
+		char32_t c = s[i];
+		if (0xD800 <= c && c <= 0xDBFF && i + 1 < s.size() && 0xDC00 <= s[i + 1] && s[i + 1] <= 0xDFFF)
+			c = 0x10000 + ((c - 0xD800) << 10) + (s[++i] - 0xDC00);
+		else if (0xD800 <= c && c <= 0xDFFF)
+			c = 0xFFFD;
+		if (c < 0x800)
+		{
+			result += static_cast<char>(0xC0 | (c >> 6));
+			result += static_cast<char>(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			result += static_cast<char>(0xE0 | (c >> 12));
+			result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+			result += static_cast<char>(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			result += static_cast<char>(0xF0 | (c >> 18));
+			result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+			result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+			result += static_cast<char>(0x80 | (c & 0x3F));
+		}
 	}
-	return s;
 }
 
-std::wstring escape_key(std::wstring key)
+std::string utf16_to_utf8(std::u16string_view s)
 {
-	key = replace_all(key, L"\r", L"&#x000013;");
-	key = replace_all(key, L"\n", L"&#x000010;");
-	key = replace_all(key, L"[", L"&#x000091;");
-	key = replace_all(key, L"]", L"&#x000093;");
-	key = replace_all(key, L"{", L"&#x000123;");
-	key = replace_all(key, L"}", L"&#x000125;");
-	return key;
+	std::string result;
+	result.reserve(s.size());
+	append_utf8(result, s);
+	return result;
 }
 
-std::wstring unescape_key(std::wstring key)
-{
-	key = replace_all(key, L"&#x000013;", L"\r");
-	key = replace_all(key, L"&#x000010;", L"\n");
-	key = replace_all(key, L"&#x000091;", L"[");
-	key = replace_all(key, L"&#x000093;", L"]");
-	key = replace_all(key, L"&#x000123;", L"{");
-	key = replace_all(key, L"&#x000125;", L"}");
-	return key;
+// Single pass over the UTF-8 bytes. Lines are found with find (memchr), only marker lines and entry payloads get
+// decoded. A payload is every line after the key line up to the next marker line, each with its line feed, and is
+// decoded in one piece once it ends.
+locres_vector read_txt_file(string_pool & pool, text_arena & arena, std::filesystem::path file)
+{
+	locres_vector lv;
+
+	mapped_file input;
+	if (!input.open(file))
+		return lv;
+	auto text = std::string_view{ reinterpret_cast<const char*>(input.bytes().data()), input.bytes().size() };
+	text = text.substr(0, text.find('\0'));
+
+	std::u16string line;
+	std::u16string s;
+	std::u16string unescaped;
+	bool in_entry = false;
+	size_t payload_begin = 0;
+
+	// The blank line separating entries ("\r\n\r\n") is cut off, except for the last entry of a file without an end
+	// marker.
+	const auto store_payload = [&] (size_t payload_end, bool trim) {
+		s.clear();
+		append_utf16(s, text.substr(payload_begin, payload_end - payload_begin));
+		if (payload_begin < payload_end && text[payload_end - 1] != '\n')
+			s += u'\n';
+		if (trim && 4 <= s.length())
+			s.resize(s.length() - 4);
+		lv.back().second.back().s = arena.store(s);
+	};
+
+	for (size_t line_begin = 0; line_begin < text.size(); )
+	{
+		const auto line_end = std::min(text.find('\n', line_begin), text.size());
+		const auto raw_line = text.substr(line_begin, line_end - line_begin);
+		const auto marker_begin = line_begin;
+		line_begin = line_end + 1;
+
+		if (!raw_line.starts_with("=>"))
+			continue;
+
+		if (4 < raw_line.length() && raw_line.starts_with("=># "))
+		{
+			if (in_entry)
+				store_payload(marker_begin, true);
+
+			in_entry = false;
+			continue;
+		}
+		if (raw_line.starts_with("=>["))
+		{
+			line.clear();
+			append_utf16(line, raw_line.substr(3));
+			if (5 < 3 + line.length())
+			{
+				if (in_entry)
+					store_payload(marker_begin, true);
+
+				auto rest = std::u16string_view{ line };
+				const auto key = unescape_key(rest.substr(0, rest.find(u']')), unescaped);
+				rest = rest.substr(rest.find(u'[') + 1);
+				const auto hash_text = rest.substr(0, rest.find(u']'));
+				const auto hash = static_cast<uint32_t>(std::stoul(std::string(hash_text.begin(), hash_text.end())));
+				lv.back().second.push_back(FEntry{ text_key::from_string(key, pool), hash, u"", u"" });
+				payload_begin = std::min(line_begin, text.size());
+				in_entry = true;
+				continue;
+			}
+		}
+		if (3 < raw_line.length() && raw_line.starts_with("=>{"))
+		{
+			if (in_entry)
+				store_payload(marker_begin, true);
+
+			in_entry = false;
+			line.clear();
+			append_utf16(line, raw_line.substr(3));
+			const auto ns = unescape_key(std::u16string_view{ line }.substr(0, line.find(u'}')), unescaped);
+			if (ns == u"[END]")
+				break;
+			lv.emplace_back();
+			lv.back().first = pool.store(ns);
+			continue;
+		}
+	}
+	if (in_entry)
+		store_payload(text.size(), false);
+
+	return lv;
 }
 
-struct FEntry
+// Writes the txt format as UTF-8 through a fixed-size buffer that goes to the file whenever it fills up, so entries
+// can be streamed in without holding the whole document in memory.
+class txt_writer
 {
-	std::wstring key;
-	uint32_t hash;
-	std::wstring s;
+public:
+	explicit txt_writer(std::filesystem::path const& file)
+		: fout(file, std::ios::binary | std::ios::out)
+	{
+		buffer.reserve(BUFFER_SIZE);
+	}
 
-	std::wstring src;
-};
+	txt_writer(txt_writer const&) = delete;
+	txt_writer & operator=(txt_writer const&) = delete;
 
-using locres_vector = std::vector<std::pair<std::wstring, std::vector<FEntry>>>;
+	~txt_writer()
+	{
+		flush();
+	}
 
-locres_vector read_txt_file(std::filesystem::path file)
-{
-	locres_vector lv;
+	void write_namespace(std::u16string_view ns)
+	{
+		buffer += "=>{";
+		append_utf8(buffer, escape_key(ns, escaped));
+		buffer += "}\r\n\r\n";
+		flush_if_full();
+	}
 
-	auto fin = std::ifstream{ file, std::ios::binary | std::ios::ate };
-	auto buffer = std::vector<char>(static_cast<size_t>(fin.tellg()) + 1);
-	fin.seekg(0, std::ios::beg);
-	fin.read(buffer.data(), buffer.size() - 1);
+	void write_source(std::u16string_view src)
+	{
+		buffer += "=># ";
+		append_utf8(buffer, src);
+		buffer += "\r\n\r\n";
+		flush_if_full();
+	}
 
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	std::wstring lines = converter.from_bytes(buffer.data());
-	auto stream = std::wstringstream{ lines };
+	void write_entry(std::u16string_view key, uint32_t hash, std::u16string_view s)
+	{
+		buffer += "=>[";
+		append_utf8(buffer, escape_key(key, escaped));
+		buffer += "][";
+		char digits[16];
+		buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), hash).ptr);
+		buffer += "]\r\n";
+		append_utf8(buffer, s);
+		buffer += "\r\n\r\n";
+		flush_if_full();
+	}
 
-	std::wstring line;
-	int mode = 0;
-	while (std::getline(stream, line))
+	void write_end()
 	{
-		if (4 < line.length() && line.substr(0, 4) == L"=># ")
-		{
-			if (mode == 1)
-				lv.back().second.back().s = lv.back().second.back().s.substr(0, lv.back().second.back().s.length() - 4);
+		buffer += "=>{[END]}\r\n";
+		flush();
+	}
 
-			mode = 0;
-			continue;
-		}
-		if (5 < line.length() && line.substr(0, 3) == L"=>[")
-		{
-			if (mode == 1)
-				lv.back().second.back().s = lv.back().second.back().s.substr(0, lv.back().second.back().s.length() - 4);
+private:
+	static constexpr size_t BUFFER_SIZE = 1024 * 1024;
 
-			line = line.substr(3);
-			const auto key = unescape_key(line.substr(0, line.find(L"]")));
-			line = line.substr(line.find(L"[") + 1);
-			const auto hash = std::stoul(line.substr(0, line.find(L"]")));
-			lv.back().second.push_back(FEntry{ key, hash, L"" });
-			mode = 1;
-			continue;
-		}
-		if (3 < line.length() && line.substr(0, 3) == L"=>{")
-		{
-			if (mode == 1)
-				lv.back().second.back().s = lv.back().second.back().s.substr(0, lv.back().second.back().s.length() - 4);
+	void flush_if_full()
+	{
+		if (BUFFER_SIZE <= buffer.size())
+			flush();
+	}
 
-			const auto ns = unescape_key(line.substr(3, line.find(L"}") - 3));
-			if (ns == L"[END]")
-				break;
-			lv.emplace_back();
-			lv.back().first = ns;
-			mode = 0;
-			continue;
-		}
-		if (mode == 1)
-			lv.back().second.back().s += line + L"\n";
+	void flush()
+	{
+		fout.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		buffer.clear();
 	}
 
-	return lv;
-}
+	std::ofstream fout;
+	std::string buffer;
+	std::u16string escaped;
+};
 
-void write_to_txt_file(locres_vector const& lv, std::filesystem::path file, bool src)
+void write_to_txt_file(locres_vector const& lv, string_pool const& pool, std::filesystem::path file, bool src)
 {
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	auto fout = std::ofstream{ file, std::ios::binary | std::ios::out };
-	std::wstring last_src = L"";
+	txt_writer writer(file);
+	std::u16string_view last_src = u"";
 	for (auto const& ns : lv)
 	{
-		const auto escaped_ns = converter.to_bytes(escape_key(ns.first));
-		fout << "=>{" << escaped_ns << "}" << '\r' << '\n' << '\r' << '\n';
+		writer.write_namespace(ns.first);
 		for (auto const& text : ns.second)
 		{
 			if (src && text.src != last_src)
 			{
-				const auto src_comment = converter.to_bytes(text.src);
-				fout << "=># " << src_comment << '\r' << '\n' << '\r' << '\n';
+				writer.write_source(text.src);
 				last_src = text.src;
 			}
-			const auto escaped_key = converter.to_bytes(escape_key(text.key));
-			const auto s = converter.to_bytes(text.s);
-			fout << "=>[" << escaped_key << "][" << text.hash << "]" << '\r' << '\n' << s << '\r' << '\n' << '\r' << '\n';
+			writer.write_entry(text.key.to_string(pool), text.hash, text.s);
 		}
 	}
-	fout << "=>{[END]}" << '\r' << '\n' << std::flush;
+	writer.write_end();
 }
 
 static const auto magic = std::vector<unsigned char>{
 	0x0E, 0x14, 0x74, 0x75, 0x67, 0x4A, 0x03, 0xFC, 0x4A, 0x15, 0x90, 0x9D, 0xC3, 0x37, 0x7F, 0x1B
 };
 
-void write_to_locres_file(bool old, locres_vector const& lv, std::filesystem::path file)
+// The locres file is built in memory and written with a single call, so the strings array offset is patched in place
+// instead of seeking back in the stream.
+class locres_image
 {
-	auto fout = std::ofstream{ file, std::ios::binary | std::ios::out };
-
-	std::streampos strings_array_offset_placeholder_offset;
-
-	if (!old)
+public:
+	void reserve(size_t size)
 	{
-		fout.write(reinterpret_cast<const char*>(magic.data()), magic.size());
+		bytes.reserve(size);
+	}
 
-		const uint8_t version = 1;
-		fout.write(reinterpret_cast<const char*>(&version), sizeof(uint8_t));
+	size_t size() const
+	{
+		return bytes.size();
+	}
 
-		const int64_t strings_array_offset_placeholder = 0;
-		strings_array_offset_placeholder_offset = fout.tellp();
-		fout.write(reinterpret_cast<const char*>(&strings_array_offset_placeholder), sizeof(int64_t));
+	void write_bytes(const void* data, size_t count)
+	{
+		std::memcpy(grow(count), data, count);
 	}
 
-	const uint32_t namespace_count = static_cast<const uint32_t>(lv.size());
-	fout.write(reinterpret_cast<const char*>(&namespace_count), sizeof(uint32_t));
+	template <typename T>
+	void write(T const& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		write_bytes(&value, sizeof(T));
+	}
 
-	std::vector<std::wstring> strings;
-	std::map<std::wstring, int32_t> strings_map;
+	template <typename T>
+	void patch(size_t offset, T const& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		std::memcpy(bytes.data() + offset, &value, sizeof(T));
+	}
 
-	const auto write_string = [&] (std::wstring s) {
+	// FString layout: ANSI when every character is 7-bit, UTF-16 with a negative length otherwise, null-terminated
+	// either way. Empty strings are a bare zero length.
+	void write_string(std::u16string_view s)
+	{
 		if (s.length() == 0)
 		{
-			const int32_t length = 0;
-			fout.write(reinterpret_cast<const char*>(&length), sizeof(int32_t));
+			write(int32_t{ 0 });
 			return;
 		}
-		bool need_unicode = false;
-		for (auto const& c : s)
-			if (!(0x00 <= c && c <= 0x7F))
-			{
-				need_unicode = true;
-				break;
-			}
+		const auto need_unicode = std::any_of(s.begin(), s.end(), [] (char16_t c) {
+			return 0x7F < c;
+		});
 		if (need_unicode)
 		{
-			const int32_t length = -static_cast<int32_t>(s.length()) - 1;
-			fout.write(reinterpret_cast<const char*>(&length), sizeof(int32_t));
-			fout.write(reinterpret_cast<const char*>(s.c_str()), s.length() * 2);
-			const uint16_t zero = 0;
-			fout.write(reinterpret_cast<const char*>(&zero), sizeof(uint16_t));
+			write(-static_cast<int32_t>(s.length()) - 1);
+			auto out = grow((s.length() + 1) * sizeof(char16_t));
+			std::memcpy(out, s.data(), s.length() * sizeof(char16_t));
+			std::memset(out + s.length() * sizeof(char16_t), 0, sizeof(char16_t));
 		}
 		else
 		{
-			const int32_t length = static_cast<int32_t>(s.length()) + 1;
-			fout.write(reinterpret_cast<const char*>(&length), sizeof(int32_t));
-			for (auto const& c : s)
-				fout.write(reinterpret_cast<const char*>(&c), sizeof(char));
-			const uint8_t zero = 0;
-			fout.write(reinterpret_cast<const char*>(&zero), sizeof(uint8_t));
+			write(static_cast<int32_t>(s.length()) + 1);
+			auto out = grow(s.length() + 1);
+			std::transform(s.begin(), s.end(), out, [] (char16_t c) {
+				return static_cast<char>(c);
+			});
+			out[s.length()] = 0;
+		}
+	}
+
+	void save(std::filesystem::path file) const
+	{
+		auto fout = std::ofstream{ file, std::ios::binary | std::ios::out };
+		fout.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+private:
+	char* grow(size_t count)
+	{
+		const auto offset = bytes.size();
+		bytes.resize(offset + count);
+		return bytes.data() + offset;
+	}
+
+	std::vector<char> bytes;
+};
+
+// Gives every distinct string its index in the strings array and counts the texts referencing it. Open addressing with
+// linear probing over views into the texts, each slot keeps the full hash so only strings with equal hashes are compared.
+class string_index
+{
+public:
+	explicit string_index(size_t expected_count)
+		: slots(std::bit_ceil(std::max<size_t>(16, expected_count * 2)))
+	{
+		strings.reserve(expected_count);
+		counts.reserve(expected_count);
+	}
+
+	int32_t insert(std::u16string_view s)
+	{
+		if (slots.size() < (strings.size() + 1) * 2)
+			rehash(slots.size() * 2);
+		const auto hash = std::hash<std::u16string_view>{}(s);
+		for (auto i = hash & (slots.size() - 1); ; i = (i + 1) & (slots.size() - 1))
+		{
+			auto & slot = slots[i];
+			if (slot.index < 0)
+			{
+				slot = { hash, static_cast<int32_t>(strings.size()) };
+				strings.push_back(s);
+				counts.push_back(1);
+				return slot.index;
+			}
+			if (slot.hash == hash && strings[slot.index] == s)
+			{
+				++counts[slot.index];
+				return slot.index;
+			}
+		}
+	}
+
+	std::vector<std::u16string_view> const& values() const
+	{
+		return strings;
+	}
+
+	std::vector<int32_t> const& ref_counts() const
+	{
+		return counts;
+	}
+
+private:
+	struct slot
+	{
+		size_t hash = 0;
+		int32_t index = -1;
+	};
+
+	void rehash(size_t size)
+	{
+		auto old_slots = std::exchange(slots, std::vector<slot>(size));
+		for (auto const& old_slot : old_slots)
+		{
+			if (old_slot.index < 0)
+				continue;
+			auto i = old_slot.hash & (slots.size() - 1);
+			while (0 <= slots[i].index)
+				i = (i + 1) & (slots.size() - 1);
+			slots[i] = old_slot;
 		}
+	}
+
+	std::vector<slot> slots;
+	std::vector<std::u16string_view> strings;
+	std::vector<int32_t> counts;
+};
+
+// Versions: 0 is the legacy layout with the strings inline, 1 moves them to a deduplicated array at the end, 2 adds
+// the entry count, namespace and key hashes (StrCrc32) and string ref counts, 3 switches the hashes to CityHash64.
+void write_to_locres_file(uint8_t version, locres_vector const& lv, string_pool const& pool, std::filesystem::path file)
+{
+	locres_image image;
+
+	// Sized for UTF-16 strings and keys of GUID length, the usual case, so the buffer rarely has to grow.
+	size_t estimated_size = magic.size() + sizeof(uint8_t) + sizeof(int64_t) + 3 * sizeof(uint32_t);
+	size_t text_count = 0;
+	for (auto const& ns : lv)
+	{
+		estimated_size += 3 * sizeof(uint32_t) + (ns.first.length() + 1) * sizeof(char16_t);
+		for (auto const& text : ns.second)
+			estimated_size += 6 * sizeof(uint32_t) + (32 + 1 + text.s.length() + 1) * sizeof(char16_t);
+		text_count += ns.second.size();
+	}
+	image.reserve(estimated_size);
+
+	size_t strings_array_offset_placeholder_offset = 0;
+
+	if (1 <= version)
+	{
+		image.write_bytes(magic.data(), magic.size());
+		image.write(version);
+
+		strings_array_offset_placeholder_offset = image.size();
+		image.write(int64_t{ 0 });
+	}
+
+	if (2 <= version)
+		image.write(static_cast<uint32_t>(text_count));
+
+	image.write(static_cast<uint32_t>(lv.size()));
+
+	auto strings = string_index(1 <= version ? text_count : 0);
+
+	const auto write_key = [&] (std::u16string_view s) {
+		if (2 <= version)
+			image.write(locres_key_hash(version, s));
+		image.write_string(s);
 	};
 
 	for (auto const& ns : lv)
 	{
-		write_string(ns.first);
-		const uint32_t key_count = static_cast<const uint32_t>(ns.second.size());
-		fout.write(reinterpret_cast<const char*>(&key_count), sizeof(uint32_t));
+		write_key(ns.first);
+		image.write(static_cast<uint32_t>(ns.second.size()));
 		for (auto const& text : ns.second)
 		{
-			write_string(text.key);
-			fout.write(reinterpret_cast<const char*>(&text.hash), sizeof(uint32_t));
-			if (!old)
+			write_key(text.key.to_string(pool));
+			image.write(text.hash);
+			if (1 <= version)
+				image.write(strings.insert(text.s));
+			else
+				image.write_string(text.s);
+		}
+	}
+
+	if (1 <= version)
+	{
+		image.patch(strings_array_offset_placeholder_offset, static_cast<int64_t>(image.size()));
+		image.write(static_cast<uint32_t>(strings.values().size()));
+		for (size_t i = 0; i < strings.values().size(); ++i)
+		{
+			image.write_string(strings.values()[i]);
+			if (2 <= version)
+				image.write(strings.ref_counts()[i]);
+		}
+	}
+
+	image.save(file);
+}
+
+// Reads locres files of versions 0 to 3 in place from a mapped file. Every count, offset and length is checked against
+// the file size. Strings of the strings array are decoded once, when the first entry referencing them is visited.
+class locres_reader
+{
+public:
+	static constexpr uint8_t LATEST_VERSION = 3;
+
+	// False if the file can't be read, is broken or has a version newer than LATEST_VERSION.
+	bool open(std::filesystem::path const& path)
+	{
+		if (!file.open(path))
+			return false;
+		const auto bytes = file.bytes();
+
+		version_ = 0;
+		body_offset = 0;
+		if (magic.size() <= bytes.size() && std::equal(magic.begin(), magic.end(), bytes.begin(), [] (unsigned char a, std::byte b) {
+			return a == static_cast<unsigned char>(b);
+		}))
+		{
+			auto ar = archive_reader{ bytes, magic.size() };
+			version_ = ar.read<uint8_t>();
+			if (!ar.ok || LATEST_VERSION < version_)
+				return false;
+			body_offset = ar.index;
+		}
+
+		strings.clear();
+		decoded.clear();
+		if (1 <= version_)
+		{
+			auto ar = archive_reader{ bytes, body_offset };
+			const auto strings_array_offset = ar.read<int64_t>();
+			if (!ar.ok || strings_array_offset < 0)
+				return false;
+			body_offset = ar.index;
+
+			ar.index = static_cast<size_t>(strings_array_offset);
+			const auto strings_count = ar.read<uint32_t>();
+			if (!fits(ar, strings_count, sizeof(int32_t)))
+				return false;
+			strings.reserve(strings_count);
+			for (uint32_t i = 0; ar.ok && i < strings_count; ++i)
+			{
+				strings.push_back(ar.read_fstring_view());
+				if (2 <= version_)
+					ar.skip(sizeof(int32_t)); // ref count
+			}
+			if (!ar.ok)
+				return false;
+			decoded.resize(strings.size());
+		}
+		return true;
+	}
+
+	uint8_t version() const
+	{
+		return version_;
+	}
+
+	// Walks the namespaces in file order: on_namespace(name, key_count) comes before the entries of every namespace,
+	// on_entry(key, source_hash, string) for each of them. The views are only valid during the call. False if the file
+	// turns out to be broken.
+	template <typename OnNamespace, typename OnEntry>
+	bool for_each(OnNamespace && on_namespace, OnEntry && on_entry)
+	{
+		auto ar = archive_reader{ file.bytes(), body_offset };
+		if (2 <= version_)
+			ar.skip(sizeof(uint32_t)); // entries count
+		const auto namespace_count = ar.read<uint32_t>();
+		if (!fits(ar, namespace_count, 2 * sizeof(uint32_t)))
+			return false;
+		for (uint32_t i = 0; i < namespace_count; ++i)
+		{
+			if (2 <= version_)
+				ar.skip(sizeof(uint32_t)); // namespace hash
+			const auto ns = read_string(ar, namespace_scratch);
+			const auto key_count = ar.read<uint32_t>();
+			if (!fits(ar, key_count, 3 * sizeof(uint32_t)))
+				return false;
+			on_namespace(ns, key_count);
+			for (uint32_t j = 0; j < key_count; ++j)
 			{
-				int32_t index = 0;
-				if (const auto it = strings_map.find(text.s); it == strings_map.end())
+				if (2 <= version_)
+					ar.skip(sizeof(uint32_t)); // key hash
+				const auto key = read_string(ar, key_scratch);
+				const auto hash = ar.read<uint32_t>();
+				std::u16string_view s;
+				if (1 <= version_)
 				{
-					index = static_cast<int32_t>(strings.size());
-					strings_map.emplace(text.s, index);
-					strings.push_back(text.s);
+					const auto index = ar.read<int32_t>();
+					if (!ar.ok || index < 0 || strings.size() <= static_cast<size_t>(index))
+						return false;
+					s = string(static_cast<size_t>(index));
 				}
 				else
 				{
-					index = it->second;
+					s = read_string(ar, string_scratch);
+					if (!ar.ok)
+						return false;
 				}
-				fout.write(reinterpret_cast<const char*>(&index), sizeof(int32_t));
-			}
-			else
-			{
-				write_string(text.s);
+				on_entry(key, hash, s);
 			}
 		}
+		return ar.ok;
+	}
+
+private:
+	// Whether count records of at least min_size bytes each can follow, so broken counts fail before anything gets
+	// reserved for them.
+	static bool fits(archive_reader const& ar, uint64_t count, size_t min_size)
+	{
+		return ar.ok && ar.index <= ar.buffer.size() && count <= (ar.buffer.size() - ar.index) / min_size;
+	}
+
+	std::u16string_view read_string(archive_reader & ar, std::u16string & scratch)
+	{
+		const auto view = ar.read_fstring_view();
+		scratch.resize(view.size());
+		view.decode(file.bytes(), scratch.data());
+		return scratch;
+	}
+
+	std::u16string_view string(size_t index)
+	{
+		if (!decoded[index])
+			decoded[index] = strings[index].decode(file.bytes(), arena);
+		return *decoded[index];
+	}
+
+	mapped_file file;
+	uint8_t version_ = 0;
+	size_t body_offset = 0; // right after the header, where the optional entries count and the namespaces begin
+	std::vector<string_view_in_buffer> strings;
+	std::vector<std::optional<std::u16string_view>> decoded;
+	text_arena arena;
+	std::u16string namespace_scratch;
+	std::u16string key_scratch;
+	std::u16string string_scratch; // inline strings of version 0
+};
+
+// Decimal digits only, values above max are clamped to it. nullopt if s is empty or has anything but digits.
+std::optional<size_t> parse_count(std::wstring_view s, size_t max)
+{
+	if (s.empty())
+		return std::nullopt;
+	size_t value = 0;
+	for (const auto c : s)
+	{
+		if (!(L'0' <= c && c <= L'9'))
+			return std::nullopt;
+		value = std::min(max, value * 10 + (c - L'0'));
 	}
+	return value;
+}
 
-	if (!old)
+// Wide console output and path conversions need a UTF-8 ctype facet. Not every POSIX host has en_US.UTF-8, so C.UTF-8
+// and the user's locale are tried next; the classic locale stays if none of them exists.
+void set_utf8_locale()
+{
+	for (const auto name : { "en_US.UTF-8", "C.UTF-8", "" })
 	{
-		const int64_t strings_array_offset = fout.tellp();
-		const uint32_t strings_array_count = static_cast<uint32_t>(strings.size());
-		fout.write(reinterpret_cast<const char*>(&strings_array_count), sizeof(uint32_t));
-		for (auto const& s : strings)
-			write_string(s);
-		fout.seekp(strings_array_offset_placeholder_offset);
-		fout.write(reinterpret_cast<const char*>(&strings_array_offset), sizeof(int64_t));
+		try
+		{
+			std::locale::global(std::locale{ std::locale::classic(), name, std::locale::ctype });
+			return;
+		}
+		catch (std::runtime_error const&)
+		{
+		}
 	}
 }
 
+#ifndef UE4TEXTEXTRACTOR_NO_MAIN // defined by selftest.cpp and the tools, which compile this file in with their own entry point
+#ifdef _WIN32
 int wmain(int argc, wchar_t ** argv)
+#else
+int main(int argc, char ** argv)
+#endif
 {
-	std::locale::global(std::locale{ std::locale::classic(), "en_US.UTF-8", std::locale::ctype });
+	set_utf8_locale();
 
+#ifdef _WIN32
 	SetConsoleOutputCP(CP_UTF8);
 	SetConsoleCP(CP_UTF8);
+#endif
 
-	std::vector<std::wstring_view> args;
+	std::vector<std::wstring> arguments;
 	for (size_t i = 0; i < argc; ++i)
-		args.emplace_back(argv[i]);
+		arguments.push_back(path_to_wstring(argv[i]));
+	std::vector<std::wstring_view> args;
+	for (auto const& argument : arguments)
+		args.emplace_back(argument);
 
 	if (args.size() < 3)
 	{
@@ -960,27 +3096,42 @@ int wmain(int argc, wchar_t ** argv)
 	}
 
 	constexpr std::wstring_view old_argument = L"-old";
+	constexpr std::wstring_view locres_version_argument = L"-locres-version=";
 	constexpr std::wstring_view raw_text_signatures_argument = L"-raw-text-signatures=";
 	constexpr std::wstring_view all_uexps_argument = L"-all-uexps";
 	constexpr std::wstring_view src_argument = L"-src";
-
-	const auto path_left = std::filesystem::path(args[1]);
-	const auto path_right = std::filesystem::path(args[2]);
-	bool old = false;
-	bool all_uexps = false;
-	std::vector<std::string> raw_text_signatures;
+	constexpr std::wstring_view jobs_argument = L"-j";
+	constexpr std::wstring_view full_scan_argument = L"-full-scan";
+	constexpr std::wstring_view stats_argument = L"-stats";
+
+	const auto path_left = std::filesystem::path(argv[1]);
+	const auto path_right = std::filesystem::path(argv[2]);
+	uint8_t locres_version = 1;
+	extract_settings settings;
 	bool src = false;
+	bool stats = false;
 
 	for (size_t i = 3; i < args.size(); ++i)
 	{
 		if (args[i] == old_argument)
 		{
-			old = true;
+			locres_version = 0;
+			continue;
+		}
+		if (args[i].starts_with(locres_version_argument))
+		{
+			const auto value = std::wstring_view(args[i]).substr(locres_version_argument.size());
+			if (value.size() != 1 || value[0] < L'0' || L'3' < value[0])
+			{
+				std::wcout << L"ERROR: Unsupported locres version, expected 0 to 3!";
+				return 1;
+			}
+			locres_version = static_cast<uint8_t>(value[0] - L'0');
 			continue;
 		}
 		if (args[i] == all_uexps_argument)
 		{
-			all_uexps = true;
+			settings.all_uexps = true;
 			continue;
 		}
 		if (args[i] == src_argument)
@@ -988,6 +3139,29 @@ int wmain(int argc, wchar_t ** argv)
 			src = true;
 			continue;
 		}
+		if (args[i] == full_scan_argument)
+		{
+			settings.full_scan = true;
+			continue;
+		}
+		if (args[i] == stats_argument)
+		{
+			stats = true;
+			continue;
+		}
+		if (args[i] == jobs_argument)
+		{
+			const auto value = i + 1 < args.size() ? parse_count(args[++i], MAX_JOBS) : std::nullopt;
+			if (!value.has_value())
+			{
+				std::wcout << L"ERROR: Wrong number of jobs, expected a number from 0 to " << MAX_JOBS << L"!";
+				return 1;
+			}
+			settings.jobs = value.value();
+			if (settings.jobs == 0)
+				settings.jobs = std::min<size_t>(MAX_JOBS, std::max(1u, std::thread::hardware_concurrency()));
+			continue;
+		}
 		if (args[i].starts_with(raw_text_signatures_argument))
 		{
 			const auto wtos = [] (std::wstring_view const& s) {
@@ -1001,11 +3175,11 @@ int wmain(int argc, wchar_t ** argv)
 			size_t pos = -1;
 			while ((pos = raw_text_signatures_value.find(L",")) != std::wstring_view::npos)
 			{
-				raw_text_signatures.push_back(wtos(raw_text_signatures_value.substr(0, pos)));
+				settings.raw_text_signatures.push_back(wtos(raw_text_signatures_value.substr(0, pos)));
 				raw_text_signatures_value.remove_prefix(pos + 1);
 			}
 			if (0 < raw_text_signatures_value.size())
-				raw_text_signatures.push_back(wtos(raw_text_signatures_value));
+				settings.raw_text_signatures.push_back(wtos(raw_text_signatures_value));
 			continue;
 		}
 	}
@@ -1013,36 +3187,71 @@ int wmain(int argc, wchar_t ** argv)
 	if (std::filesystem::is_directory(path_left))
 	{
 		std::vector<FText> texts;
-		directory_extract(path_left, path_left, raw_text_signatures, all_uexps, texts);
-		std::set<std::wstring> namespaces;
-		for (auto const& text : texts)
-			namespaces.insert(text.ns);
+		string_pool pool;
+		auto arenas = std::vector<text_arena>(settings.jobs);
+		scan_counters counters;
+		settings.build_signatures();
+		directory_extract(path_left, settings, pool, arenas, counters, texts);
+		if (stats)
+		{
+			const auto megabytes = static_cast<double>(counters.bytes_scanned) / (1024 * 1024);
+			const auto per_megabyte = [&] (uint64_t count) {
+				return 0 < megabytes ? static_cast<double>(count) / megabytes : 0.0;
+			};
+			std::wcout << std::fixed << std::setprecision(1)
+				<< L"Scanned: " << megabytes << L" MB" << std::endl
+				<< L"Strings checked in place: " << counters.strings_checked << L" (" << per_megabyte(counters.strings_checked) << L" per MB)" << std::endl
+				<< L"Strings reused from the offset cache: " << counters.string_cache_hits << L" (" << per_megabyte(counters.string_cache_hits) << L" per MB)" << std::endl
+				<< L"Strings decoded: " << counters.strings_decoded << L" (" << per_megabyte(counters.strings_decoded) << L" per MB)" << std::endl
+				<< L"Chunks of large files scanned: " << counters.chunks_scanned << L", by free threads: " << counters.chunks_scanned_by_free_threads << std::endl;
+			std::wcout.unsetf(std::ios::floatfield);
+		}
+		// Group in one pass, the first text wins for every key. Namespaces go out sorted, keys in the order found.
 		locres_vector lv;
-		lv.reserve(namespaces.size());
-		for (auto const& ns : namespaces)
+		std::unordered_map<uint32_t, size_t> namespace_indices;
+		std::vector<std::unordered_set<text_key>> namespace_keys;
+		for (auto const& text : texts)
 		{
-			lv.emplace_back();
-			lv.back().first = ns;
-			std::set<std::wstring> unique_check;
-			for (auto const& text : texts)
+			const auto [it, inserted] = namespace_indices.try_emplace(text.ns, lv.size());
+			if (inserted)
 			{
-				if (text.ns != ns)
-					continue;
-				if (unique_check.find(text.key) != unique_check.end())
-					continue;
-				unique_check.insert(text.key);
-				lv.back().second.push_back(FEntry{ text.key, crc32::StrCrc32(text.s), text.s, text.src });
+				lv.emplace_back(pool.view(text.ns), std::vector<FEntry>{});
+				namespace_keys.emplace_back();
 			}
+			if (!namespace_keys[it->second].insert(text.key).second)
+				continue;
+			lv[it->second].second.push_back(FEntry{ text.key, 0, text.s, pool.view(text.src) });
+		}
+		namespace_indices.clear();
+		namespace_keys.clear();
+		// Hashed directly, a content-keyed memo costs more than StrCrc32 of the short strings it saves.
+		const auto hashing_start = std::chrono::steady_clock::now();
+		size_t hashed = 0;
+		for (auto & [ns, entries] : lv)
+		{
+			for (auto & entry : entries)
+				entry.hash = crc32::StrCrc32(entry.s);
+			hashed += entries.size();
+		}
+		if (stats)
+		{
+			const std::chrono::duration<double, std::milli> hashing_time = std::chrono::steady_clock::now() - hashing_start;
+			std::wcout << std::fixed << std::setprecision(1)
+				<< L"Source strings hashed: " << hashed << L" in " << hashing_time.count() << L" ms" << std::endl;
+			std::wcout.unsetf(std::ios::floatfield);
 		}
+		std::sort(lv.begin(), lv.end(), [] (auto const& a, auto const& b) {
+			return a.first < b.first;
+		});
 
 		if (path_right.extension() == L".txt")
 		{
-			write_to_txt_file(lv, path_right, src);
+			write_to_txt_file(lv, pool, path_right, src);
 			return 0;
 		}
 		else if (path_right.extension() == L".locres")
 		{
-			write_to_locres_file(old, lv, path_right);
+			write_to_locres_file(locres_version, lv, pool, path_right);
 			return 0;
 		}
 		else
@@ -1053,159 +3262,53 @@ int wmain(int argc, wchar_t ** argv)
 	}
 	else if (path_left.extension() == L".locres" && path_right.extension() == L".txt")
 	{
-		auto fin = std::ifstream{ path_left, std::ios::binary | std::ios::ate };
-		auto buffer = std::vector<char>(fin.tellg());
-		fin.seekg(0, std::ios::beg);
-		fin.read(buffer.data(), buffer.size());
-
-		uint8_t version = 0;
-		size_t index = 0;
-
-		if (magic.size() <= buffer.size())
-		{
-			bool found = true;
-			for (size_t i = 0; i < magic.size(); ++i)
-				if (static_cast<unsigned char>(buffer[i]) != magic[i])
-				{
-					found = false;
-					break;
-				}
-			if (found)
-			{
-				index += magic.size();
-				version = *reinterpret_cast<const uint8_t*>(buffer.data() + index);
-				index += sizeof(uint8_t);
-			}
-		}
-
-		if (!(0 <= version && version <= 3))
+		locres_reader reader;
+		if (!reader.open(path_left))
 		{
-			std::wcout << L"ERROR: LocRes format too new!";
+			if (locres_reader::LATEST_VERSION < reader.version())
+				std::wcout << L"ERROR: LocRes format too new!";
+			else
+				std::wcout << L"ERROR: Can't read locres file!";
 			return 1;
 		}
 
-		const auto read_string = [&] () -> std::wstring {
-			auto length = static_cast<int64_t>(*reinterpret_cast<const int*>(buffer.data() + index));
-			index += 4;
-			if (length == 0)
-				return L"";
-			if (length < 0)
-			{
-				length = -length;
-				std::wstring s;
-				for (size_t i = index; i < index + 2 * length - 2; i += 2)
-				{
-					const auto ch = *reinterpret_cast<const wchar_t*>(buffer.data() + i);
-					s += ch;
-				}
-				index += length * 2;
-				return s;
-			}
-			else
-			{
-				std::wstring s;
-				for (size_t i = index; i < index + length - 1; ++i)
-				{
-					const auto ch = buffer[i];
-					s += ch;
-				}
-				index += length;
-				return s;
-			}
-		};
-
-		std::vector<std::wstring> strings;
-
-		if (1 <= version)
-		{
-			const auto strings_array_offset = *reinterpret_cast<const int64_t*>(buffer.data() + index);
-			index += sizeof(int64_t);
-
-			const auto restore_index_point = index;
-
-			index = strings_array_offset;
-
-			const auto strings_array_count = *reinterpret_cast<const uint32_t*>(buffer.data() + index);
-			index += sizeof(uint32_t);
-
-			strings.reserve(strings_array_count);
-
-			for (size_t i = 0; i < strings_array_count; ++i)
-			{
-				strings.push_back(read_string());
-				if (2 <= version)
-					index += sizeof(int32_t);
+		// Streamed, only the strings array is held in memory.
+		txt_writer writer(path_right);
+		const auto ok = reader.for_each(
+			[&] (std::u16string_view ns, uint32_t) {
+				writer.write_namespace(ns);
+			},
+			[&] (std::u16string_view key, uint32_t hash, std::u16string_view s) {
+				writer.write_entry(key, hash, s);
 			}
-
-			index = restore_index_point;
-		}
-
-		if (2 <= version)
-			index += sizeof(uint32_t);
-
-		const auto namespace_count = *reinterpret_cast<const uint32_t*>(buffer.data() + index);
-		index += sizeof(uint32_t);
-
-		locres_vector lv;
-		lv.reserve(namespace_count);
-
-		for (size_t i = 0; i < namespace_count; ++i)
+		);
+		if (!ok)
 		{
-			if (version == 2 || version == 3)
-				index += sizeof(uint32_t);
-			const auto ns = read_string();
-
-			const auto key_count = *reinterpret_cast<const uint32_t*>(buffer.data() + index);
-			index += sizeof(uint32_t);
-
-			lv.emplace_back();
-			lv.back().first = ns;
-			lv.back().second.reserve(key_count);
-
-			for (size_t j = 0; j < key_count; ++j)
-			{
-				if (version == 2 || version == 3)
-					index += sizeof(uint32_t);
-
-				const auto key = read_string();
-
-				const auto hash = *reinterpret_cast<const uint32_t*>(buffer.data() + index);
-				index += sizeof(uint32_t);
-
-				std::wstring str;
-				if (1 <= version)
-				{
-					const auto str_index = *reinterpret_cast<const int32_t*>(buffer.data() + index);
-					index += sizeof(int32_t);
-					str = strings[str_index];
-				}
-				else
-				{
-					str = read_string();
-				}
-
-				lv.back().second.push_back(FEntry{ key, hash, str });
-			}
+			std::wcout << L"ERROR: Broken locres file!";
+			return 1;
 		}
-
-		write_to_txt_file(lv, path_right, false);
+		writer.write_end();
 
 		return 0;
 	}
 	else if (path_left.extension() == L".txt" && path_right.extension() == L".locres")
 	{
-		const auto lv = read_txt_file(path_left);
-		write_to_locres_file(old, lv, path_right);
+		string_pool pool;
+		text_arena arena;
+		const auto lv = read_txt_file(pool, arena, path_left);
+		write_to_locres_file(locres_version, lv, pool, path_right);
 		return 0;
 	}
 	else if (path_left.extension() == L".txt" && path_right.extension() == L".txt")
 	{
-		const auto lv_src = read_txt_file(path_left);
-		auto lv = read_txt_file(path_right);
+		string_pool pool;
+		text_arena arena;
+		const auto lv_src = read_txt_file(pool, arena, path_left);
+		auto lv = read_txt_file(pool, arena, path_right);
 
 		for (auto const& ns_src : lv_src)
 		{
-			auto & ns = [&] () -> std::pair<std::wstring, std::vector<FEntry>> & {
+			auto & ns = [&] () -> std::pair<std::u16string_view, std::vector<FEntry>> & {
 				for (auto & ns_dst : lv)
 					if (ns_dst.first == ns_src.first)
 						return ns_dst;
@@ -1226,10 +3329,11 @@ int wmain(int argc, wchar_t ** argv)
 			}
 		}
 
-		write_to_txt_file(lv, path_right, false);
+		write_to_txt_file(lv, pool, path_right, false);
 		return 0;
 	}
 
 	print_help();
 	return 1;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,737 @@
+// Self-tests and benchmarks for the building blocks of main.cpp, which is compiled in here without its entry point.
+// The end-to-end tests live in the tests submodule, these cover what a whole extraction can't pin down: hashes that
+// end up in locres files, fast paths that must agree with their fallbacks and parsing of synthetic packages.
+//
+// UE4TextExtractorSelfTest.exe          runs the self-tests, returns 1 if any of them failed
+// UE4TextExtractorSelfTest.exe -bench   runs the benchmarks afterwards
+#define UE4TEXTEXTRACTOR_NO_MAIN
+#include "main.cpp"
+
+#include <chrono>
+#include <random>
+
+namespace selftest
+{
+	size_t failures = 0;
+
+	void check(bool condition, std::wstring_view what)
+	{
+		if (condition)
+			return;
+		std::wcout << L"FAILED: " << what << std::endl;
+		++failures;
+	}
+
+	template <typename Function>
+	double seconds(Function && function)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	double megabytes_per_second(size_t bytes, double seconds)
+	{
+		return static_cast<double>(bytes) / (1024 * 1024) / seconds;
+	}
+
+	volatile uint64_t sink = 0; // keeps the benchmarked work from being optimized away
+
+	std::string random_string(std::mt19937 & random, size_t length, char first, char last)
+	{
+		auto distribution = std::uniform_int_distribution<int>(first, last);
+		std::string s(length, '\0');
+		for (auto & c : s)
+			c = static_cast<char>(distribution(random));
+		return s;
+	}
+
+	byte_span as_bytes(std::string_view s)
+	{
+		return std::as_bytes(std::span(s.data(), s.size()));
+	}
+
+	// Many short signatures over a small alphabet, so the automaton grows to thousands of states while the transition
+	// table is reallocated under add() and the signatures share prefixes and suffixes.
+	void test_signature_matcher()
+	{
+		auto random = std::mt19937{ 4 };
+		auto signatures = std::vector<std::pair<std::string, uint32_t>>();
+		auto matcher = signature_matcher{};
+		for (size_t i = 0; i < 3000; ++i)
+		{
+			auto signature = random_string(random, 1 + i % 12, 'a', 'f');
+			auto tag = uint32_t{ 1 } << (i % 2);
+			if (1500 <= i)
+			{
+				signature = "z" + signature; // rare tags, so not every scan stops after a few bytes
+				tag <<= 2;
+			}
+			matcher.add(signature, tag);
+			signatures.emplace_back(std::move(signature), tag);
+		}
+		matcher.build();
+
+		for (size_t i = 0; i < 200; ++i)
+		{
+			const auto data = random_string(random, i * 7, 'a', 'z');
+			uint32_t expected = 0;
+			for (auto const& [signature, tag] : signatures)
+				if (data.find(signature) != std::string::npos)
+					expected |= tag;
+			check(matcher.scan(as_bytes(data), 0xF) == expected, L"signature_matcher finds the same tags as std::string::find");
+		}
+		check(matcher.scan(byte_span{}, 0xF) == 0, L"signature_matcher finds nothing in empty data");
+	}
+
+	// The asset probe before the matcher: every signature is tested at every offset.
+	void bench_signature_matcher()
+	{
+		auto random = std::mt19937{ 4 };
+		const auto data = random_string(random, 64 * 1024 * 1024, ' ', '~');
+		auto signatures = std::vector<std::string>{ "Blueprint", "TextProperty", "StringTable" };
+		for (size_t i = 0; i < 20; ++i)
+			signatures.push_back("RawTextSignature" + std::to_string(i));
+
+		auto matcher = signature_matcher{};
+		for (size_t i = 0; i < signatures.size(); ++i)
+			matcher.add(signatures[i], uint32_t{ 1 } << std::min<size_t>(i, 3));
+		matcher.build();
+
+		const auto per_offset = seconds([&] {
+			uint32_t found = 0;
+			for (size_t i = 0; i < data.size(); ++i)
+				for (size_t j = 0; j < signatures.size(); ++j)
+					if (test_signature(signatures[j], as_bytes(data), i))
+						found |= uint32_t{ 1 } << std::min<size_t>(j, 3);
+			sink = sink + found;
+		});
+		const auto automaton = seconds([&] {
+			sink = sink + matcher.scan(as_bytes(data), 0xF);
+		});
+		std::wcout << std::fixed << std::setprecision(1)
+			<< L"Signature probe, " << signatures.size() << L" signatures, 64 MB without a match: per-offset loop "
+			<< megabytes_per_second(data.size(), per_offset) << L" MB/s, Aho-Corasick " << megabytes_per_second(data.size(), automaton) << L" MB/s" << std::endl;
+		std::wcout.unsetf(std::ios::floatfield);
+	}
+
+	// Little-endian serialization of synthetic package data, the reverse of archive_reader.
+	struct archive_writer
+	{
+		std::vector<std::byte> bytes;
+
+		template <typename T>
+		void write(T value)
+		{
+			const auto raw = std::bit_cast<std::array<std::byte, sizeof(T)>>(value);
+			bytes.insert(bytes.end(), raw.begin(), raw.end());
+		}
+
+		void write_fstring(std::string_view s)
+		{
+			write<int32_t>(static_cast<int32_t>(s.size() + 1));
+			const auto raw = as_bytes(s);
+			bytes.insert(bytes.end(), raw.begin(), raw.end());
+			bytes.push_back(std::byte{ 0 });
+		}
+	};
+
+	// Every legacy version serializes the custom versions differently: -2 as enums, -3 to -5 as guids with a friendly
+	// name and -6 and below in the optimized form without the name.
+	void test_package_summary()
+	{
+		for (const auto legacy_file_version : { -2, -3, -4, -5, -6, -7 })
+		{
+			auto ar = archive_writer{};
+			ar.write<uint32_t>(PACKAGE_FILE_TAG);
+			ar.write<int32_t>(legacy_file_version);
+			if (legacy_file_version != -4)
+				ar.write<int32_t>(864); // LegacyUE3Version
+			ar.write<int32_t>(VER_UE4_ADDED_PACKAGE_SUMMARY_LOCALIZATION_ID);
+			ar.write<int32_t>(0); // FileVersionLicenseeUE4
+			ar.write<int32_t>(2);
+			for (int32_t i = 0; i < 2; ++i)
+			{
+				if (legacy_file_version == -2)
+				{
+					ar.write<int32_t>(i); // Tag
+				}
+				else
+				{
+					for (int32_t j = 0; j < 4; ++j)
+						ar.write<uint32_t>(0x11111111 * (i + j + 1)); // Key
+				}
+				ar.write<int32_t>(10 + i); // Version
+				if (-5 <= legacy_file_version && legacy_file_version <= -3)
+					ar.write_fstring("FriendlyName");
+			}
+			ar.write<int32_t>(1000); // TotalHeaderSize
+			ar.write_fstring("None");
+			ar.write<uint32_t>(PKG_FilterEditorOnly);
+			ar.write<int32_t>(3); // NameCount
+			ar.write<int32_t>(120); // NameOffset
+			ar.write<int32_t>(0); // GatherableTextDataCount
+			ar.write<int32_t>(0); // GatherableTextDataOffset
+			ar.write<int32_t>(4); // ExportCount
+			ar.write<int32_t>(300); // ExportOffset
+			ar.write<int32_t>(5); // ImportCount
+			ar.write<int32_t>(200); // ImportOffset
+			ar.bytes.resize(1000);
+
+			const auto what = L"read_package_summary reads version " + std::to_wstring(legacy_file_version);
+			const auto summary = read_package_summary(ar.bytes);
+			check(summary.has_value(), what);
+			if (!summary.has_value())
+				continue;
+			check(summary->legacy_file_version == legacy_file_version && summary->file_version_ue4 == VER_UE4_ADDED_PACKAGE_SUMMARY_LOCALIZATION_ID, what + L": versions");
+			check(summary->total_header_size == 1000 && summary->package_flags == PKG_FilterEditorOnly, what + L": header size and flags");
+			check(summary->name_count == 3 && summary->name_offset == 120, what + L": name map");
+			check(summary->export_count == 4 && summary->export_offset == 300, what + L": export map");
+			check(summary->import_count == 5 && summary->import_offset == 200, what + L": import map");
+		}
+	}
+
+	// UE's StrCrc32: every character goes through the byte table as a 32-bit little-endian unit, one byte at a time.
+	uint32_t reference_str_crc32(std::u16string_view string)
+	{
+		uint32_t crc = 0xFFFFFFFF;
+		for (const auto ch : string)
+		{
+			uint32_t unit = ch;
+			for (size_t i = 0; i < 4; ++i, unit >>= 8)
+				crc = (crc >> 8) ^ crc32::CRCTablesSB8[(crc ^ unit) & 0xFF];
+		}
+		return ~crc;
+	}
+
+	// Lengths around every loop bound of the table and PCLMULQDQ paths, at every offset into a 16-byte block.
+	void test_str_crc32()
+	{
+		auto random = std::mt19937{ 16 };
+		auto distribution = std::uniform_int_distribution<int>(0, 0xFFFF);
+		auto buffer = std::u16string(300 + 8, u'\0');
+		for (auto & ch : buffer)
+			ch = static_cast<char16_t>(distribution(random));
+
+		check(crc32::StrCrc32(u"") == 0 && crc32::StrCrc32(u"Hello") == reference_str_crc32(u"Hello"), L"StrCrc32 of short strings");
+#if defined(_M_X64) || defined(__x86_64__)
+		const bool pclmul = crc32::has_pclmul();
+		if (!pclmul)
+			std::wcout << L"PCLMULQDQ isn't supported, only the table path is tested" << std::endl;
+#endif
+		for (size_t offset = 0; offset < 8; ++offset)
+		{
+			for (size_t length = 0; length <= 300; ++length)
+			{
+				const auto string = std::u16string_view(buffer).substr(offset, length);
+				const auto expected = reference_str_crc32(string);
+				const auto what = L"StrCrc32 at offset " + std::to_wstring(offset) + L", length " + std::to_wstring(length);
+				check(crc32::StrCrc32(string) == expected, what);
+				check(~crc32::update_tables(0xFFFFFFFF, string, 0) == expected, what + L" without PCLMULQDQ");
+#if defined(_M_X64) || defined(__x86_64__)
+				if (pclmul && 16 <= length)
+				{
+					size_t done = 0;
+					const auto crc = crc32::update_pclmul(0xFFFFFFFF, string, done);
+					check(~crc32::update_tables(crc, string, done) == expected, what + L" with PCLMULQDQ from the first character");
+				}
+#endif
+			}
+		}
+	}
+
+	// Known answers of CityHash64 1.1 for the bytes i * 37 + 11, from the reference implementation. The lengths cover
+	// every branch: 0 to 16, 17 to 32, 33 to 64 and the 64-byte loop with its tail.
+	void test_city_hash()
+	{
+		constexpr std::pair<size_t, uint64_t> KNOWN_ANSWERS[] = {
+			{ 0, 0x9ae16a3b2f90404f }, { 1, 0x4271b80e2915c76a }, { 3, 0x373a2b2a12e0c581 }, { 4, 0xcc1e778137ae6d69 },
+			{ 7, 0x960838fbc6d9c975 }, { 8, 0x7d507025ed4eecfd }, { 15, 0x834f200cfa7ed95f }, { 16, 0xd836480326a974d6 },
+			{ 17, 0x5cded6cb65c9dac6 }, { 24, 0xa71d9fc06b55102b }, { 31, 0x52a467e87c92d522 }, { 32, 0xa03300e1b2be6da7 },
+			{ 33, 0x6e14215d4c7200d4 }, { 48, 0x17c28ebc25e42153 }, { 63, 0xc9fc77dead95c3aa }, { 64, 0x2a7ab541551d3235 },
+			{ 65, 0x5709ecef010a51e4 }, { 127, 0xecd6ea5dfa196e8c }, { 128, 0xa9e79ad8f1c9f5a7 }, { 129, 0x6bb7bad48ee8ebe7 },
+			{ 300, 0x5b36deaf75a108de }, { 1000, 0xa9b12bac5693383e },
+		};
+
+		for (size_t offset = 0; offset < 8; ++offset)
+		{
+			auto data = std::string(offset + 1000, '\0');
+			for (size_t i = 0; i < 1000; ++i)
+				data[offset + i] = static_cast<char>(i * 37 + 11);
+			for (auto const& [length, hash] : KNOWN_ANSWERS)
+				check(cityhash::CityHash64(data.data() + offset, length) == hash, L"CityHash64 at offset " + std::to_wstring(offset) + L", length " + std::to_wstring(length));
+		}
+
+		// The UTF-16 bytes of the key, folded to 32 bits the way UE's FLocKey does.
+		check(locres_key_hash(3, u"Key_\u0416001") == 0xcb7b24f2, L"locres_key_hash of a version 3 key");
+	}
+
+	// ANSI strings are Latin-1, the same on platforms where char is signed and where it is unsigned.
+	void test_ansi_strings()
+	{
+		const auto bytes = as_bytes("Caf\xE9 \xA0\xFF\x85");
+		const auto cafe = string_view_in_buffer{ 0, 4, false };
+		check(cafe.decode(bytes) == u"Caf\u00E9" && cafe.at(bytes, 3) == u'\u00E9', L"ANSI bytes decode as Latin-1");
+		check(valid_run<char>(bytes, 0, 7), L"Latin-1 letters and spaces are valid in ANSI strings");
+		check(!valid_run<char>(bytes, 7, 1), L"C1 controls are invalid in ANSI strings");
+	}
+
+	void test_parse_count()
+	{
+		check(parse_count(L"0", MAX_JOBS) == 0 && parse_count(L"8", MAX_JOBS) == 8 && parse_count(L"256", MAX_JOBS) == 256, L"parse_count reads numbers");
+		check(parse_count(L"257", MAX_JOBS) == MAX_JOBS && parse_count(L"99999999999999999999999", MAX_JOBS) == MAX_JOBS, L"parse_count clamps large numbers");
+		check(!parse_count(L"", MAX_JOBS) && !parse_count(L"abc", MAX_JOBS) && !parse_count(L"4x", MAX_JOBS) && !parse_count(L"-1", MAX_JOBS), L"parse_count rejects anything but digits");
+	}
+
+	// FText properties with a GUID key between random filler, dense enough that many of them straddle the chunk
+	// borders of a parallel scan.
+	std::vector<std::byte> make_scan_buffer(size_t size, uint32_t seed)
+	{
+		auto random = std::mt19937{ seed };
+		auto ar = archive_writer{};
+		ar.bytes.reserve(size + 256);
+		for (size_t i = 0; ar.bytes.size() < size; ++i)
+		{
+			for (auto n = random() % 300; 0 < n; --n)
+				ar.write<uint8_t>(static_cast<uint8_t>(random()));
+			ar.write<int32_t>(0); // Flags
+			ar.write<int8_t>(0); // ETextHistoryType::Base
+			ar.write_fstring("Game");
+			ar.write_fstring(random_string(random, 32, 'A', 'F'));
+			ar.write_fstring("Text number " + std::to_string(i));
+		}
+		ar.bytes.resize(size);
+		return std::move(ar.bytes);
+	}
+
+	bool same_texts(std::vector<FText> const& a, std::vector<FText> const& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [] (FText const& x, FText const& y) {
+			return x.ns == y.ns && x.key == y.key && x.s == y.s && x.src == y.src;
+		});
+	}
+
+	// The chunked scan must stitch its chunks into exactly the texts and end index of the serial scan.
+	void test_chunked_scan()
+	{
+		const auto bytes = make_scan_buffer(CHUNK_SCAN_MIN_BUFFER_SIZE + 7 * 1024 * 1024 + 123, 3);
+		const auto buffer = byte_span(bytes);
+		const auto detectors = text_detectors{ true, true, true, false };
+		string_pool pool;
+		for (auto const& [begin, end] : { std::pair<size_t, size_t>{ 0, buffer.size() }, std::pair<size_t, size_t>{ 1001, buffer.size() - 777 } })
+		{
+			text_arena serial_arena;
+			scan_counters serial_counters;
+			std::vector<FText> serial_texts;
+			auto serial = thread_budget{ 1, 0 };
+			const auto serial_index = scan_buffer(buffer, begin, end, detectors, serial, pool, serial_arena, serial_counters, serial_texts);
+			check(100000 < serial_texts.size(), L"scan_buffer finds the texts of the synthetic buffer");
+
+			for (const size_t jobs : { 2, 3, 8 })
+			{
+				text_arena arena;
+				scan_counters counters;
+				std::vector<FText> texts;
+				auto threads = thread_budget{ jobs, jobs - 1 };
+				const auto index = scan_buffer(buffer, begin, end, detectors, threads, pool, arena, counters, texts);
+				const auto what = L"scan_buffer with " + std::to_wstring(jobs) + L" jobs from " + std::to_wstring(begin);
+				check(1 < counters.chunks_scanned, what + L" splits the buffer into chunks");
+				check(index == serial_index, what + L" stops where the serial scan does");
+				check(same_texts(texts, serial_texts), what + L" finds the texts of the serial scan");
+			}
+		}
+	}
+
+	// One large file among small ones: once the workers run out of small files, they scan chunks of the large one.
+	void test_parallel_directory_extract()
+	{
+		const auto root = std::filesystem::temp_directory_path() / "UE4TextExtractorSelfTest";
+		std::filesystem::remove_all(root);
+		std::filesystem::create_directories(root);
+		for (size_t i = 0; i < 8; ++i)
+		{
+			const auto bytes = make_scan_buffer(i == 0 ? CHUNK_SCAN_MIN_BUFFER_SIZE + 16 * 1024 * 1024 : 256 * 1024, static_cast<uint32_t>(i));
+			auto fout = std::ofstream{ root / ("file" + std::to_string(i) + ".uexp"), std::ios::binary };
+			fout.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		}
+
+		extract_settings settings;
+		settings.all_uexps = true;
+		string_pool pool;
+		auto serial_arenas = std::vector<text_arena>(1);
+		scan_counters serial_counters;
+		std::vector<FText> serial_texts;
+		directory_extract(root, settings, pool, serial_arenas, serial_counters, serial_texts);
+
+		settings.jobs = 4;
+		auto arenas = std::vector<text_arena>(settings.jobs);
+		scan_counters counters;
+		std::vector<FText> texts;
+		directory_extract(root, settings, pool, arenas, counters, texts);
+		check(same_texts(texts, serial_texts), L"directory_extract with 4 jobs finds the texts of 1 job");
+		check(serial_counters.chunks_scanned == 0, L"directory_extract with 1 job doesn't split files");
+		check(0 < counters.chunks_scanned_by_free_threads, L"directory_extract hands free threads to the large file");
+		std::filesystem::remove_all(root);
+	}
+
+	// The AVX2 and SSE2 kernels of printable_ascii_run compare signed bytes and words, so the units around 0x7F, 0x80,
+	// 0xFF and 0x8000 are the ones that could slip through. Runs of every length end at every position of a block.
+	template <typename Char>
+	void check_printable_ascii_run(std::mt19937 & random)
+	{
+		const auto units = sizeof(Char) == 1
+			? std::vector<uint16_t>{ 0x00, 0x1F, 0x7F, 0x80, 0x9F, 0xA0, 0xE9, 0xFF }
+			: std::vector<uint16_t>{ 0x0000, 0x001F, 0x007F, 0x0080, 0x00FF, 0x0100, 0x0430, 0x7F20, 0x8000, 0x8041, 0xFF20, 0xFFFF };
+		auto printable = std::uniform_int_distribution<int>(0x20, 0x7E);
+		std::vector<std::byte> bytes(160 * sizeof(Char));
+		for (size_t length = 0; length <= 100; ++length)
+		{
+			for (size_t offset = 0; offset < 32; ++offset)
+			{
+				// a printable run of length units, then a unit that may or may not end it
+				for (size_t i = 0; i < bytes.size() / sizeof(Char); ++i)
+				{
+					const auto unit = static_cast<Char>(i < offset + length || random() % 2 == 0 ? printable(random) : units[random() % units.size()]);
+					std::memcpy(bytes.data() + i * sizeof(Char), &unit, sizeof(Char));
+				}
+				const auto end = static_cast<Char>(units[random() % units.size()]);
+				std::memcpy(bytes.data() + (offset + length) * sizeof(Char), &end, sizeof(Char));
+
+				const auto count = length + 1 + random() % 20;
+				size_t expected = 0;
+				while (expected < count && 0x20 <= read_code_unit<Char>(bytes, (offset + expected) * sizeof(Char)) && read_code_unit<Char>(bytes, (offset + expected) * sizeof(Char)) <= 0x7E)
+					++expected;
+				bool expected_valid = true;
+				for (size_t i = 0; i < count; ++i)
+					expected_valid = expected_valid && good_ch(read_code_unit<Char>(bytes, (offset + i) * sizeof(Char)));
+
+				const auto what = std::wstring(sizeof(Char) == 1 ? L"ANSI" : L"UTF-16") + L" run of length " + std::to_wstring(length) + L" at offset " + std::to_wstring(offset);
+				check(printable_ascii_run<Char>(bytes, offset * sizeof(Char), count) == expected, L"printable_ascii_run of " + what);
+				check(valid_run<Char>(bytes, offset * sizeof(Char), count) == expected_valid, L"valid_run of " + what);
+			}
+		}
+	}
+
+	void test_printable_ascii_run()
+	{
+		auto random = std::mt19937{ 8 };
+		check_printable_ascii_run<char>(random);
+		check_printable_ascii_run<char16_t>(random);
+	}
+
+	// append_utf8 one code unit at a time, without the ASCII run kernel.
+	std::string reference_utf8(std::u16string_view s)
+	{
+		std::string result;
+		for (size_t i = 0; i < s.size(); ++i)
+		{
+			char32_t c = s[i];
+			if (0xD800 <= c && c <= 0xDBFF && i + 1 < s.size() && 0xDC00 <= s[i + 1] && s[i + 1] <= 0xDFFF)
+				c = 0x10000 + ((c - 0xD800) << 10) + (s[++i] - 0xDC00);
+			else if (0xD800 <= c && c <= 0xDFFF)
+				c = 0xFFFD;
+			if (c < 0x80)
+			{
+				result += static_cast<char>(c);
+			}
+			else if (c < 0x800)
+			{
+				result += static_cast<char>(0xC0 | (c >> 6));
+				result += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000)
+			{
+				result += static_cast<char>(0xE0 | (c >> 12));
+				result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				result += static_cast<char>(0xF0 | (c >> 18));
+				result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+				result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (c & 0x3F));
+			}
+		}
+		return result;
+	}
+
+	// ASCII runs of every length mod 16 between 2- and 3-byte characters, surrogate pairs and lone surrogates, so the
+	// SSE2 narrowing in append_utf8 starts and stops at every position of a block.
+	void test_append_utf8()
+	{
+		auto random = std::mt19937{ 24 };
+		auto ascii = std::uniform_int_distribution<int>(0x00, 0x7F);
+		auto two_bytes = std::uniform_int_distribution<int>(0x80, 0x7FF);
+		auto three_bytes = std::uniform_int_distribution<int>(0x800, 0xFFFF - 0x800);
+		auto high = std::uniform_int_distribution<int>(0xD800, 0xDBFF);
+		auto low = std::uniform_int_distribution<int>(0xDC00, 0xDFFF);
+		for (size_t n = 0; n < 2000; ++n)
+		{
+			std::u16string s;
+			for (auto pieces = random() % 12; 0 < pieces; --pieces)
+			{
+				switch (random() % 6)
+				{
+				case 0:
+				case 1:
+					for (auto length = n % 16 + 16 * (random() % 4); 0 < length; --length)
+						s += static_cast<char16_t>(ascii(random));
+					break;
+				case 2:
+					s += static_cast<char16_t>(two_bytes(random));
+					break;
+				case 3:
+				{
+					const auto c = three_bytes(random);
+					s += static_cast<char16_t>(c < 0xD800 ? c : c + 0x800); // skip the surrogates
+					break;
+				}
+				case 4:
+					s += static_cast<char16_t>(high(random));
+					s += static_cast<char16_t>(low(random));
+					break;
+				default:
+					s += static_cast<char16_t>(random() % 2 == 0 ? high(random) : low(random));
+					break;
+				}
+			}
+			auto result = std::string("prefix");
+			append_utf8(result, s);
+			check(result == "prefix" + reference_utf8(s), L"append_utf8 of random string " + std::to_wstring(n));
+		}
+	}
+
+	// The six-pass escaping that escape_key and unescape_key replaced. replace_all advances by the length of the
+	// replacement, the old one advanced by the length of the pattern and skipped sequences right after a replaced one.
+	std::u16string replace_all(std::u16string s, std::u16string const& from, std::u16string const& to)
+	{
+		size_t pos = 0;
+		while ((pos = s.find(from, pos)) != std::u16string::npos)
+		{
+			s.replace(pos, from.length(), to);
+			pos += to.length();
+		}
+		return s;
+	}
+
+	std::u16string reference_escape_key(std::u16string key)
+	{
+		key = replace_all(key, u"\r", u"&#x000013;");
+		key = replace_all(key, u"\n", u"&#x000010;");
+		key = replace_all(key, u"[", u"&#x000091;");
+		key = replace_all(key, u"]", u"&#x000093;");
+		key = replace_all(key, u"{", u"&#x000123;");
+		key = replace_all(key, u"}", u"&#x000125;");
+		return key;
+	}
+
+	std::u16string reference_unescape_key(std::u16string key)
+	{
+		key = replace_all(key, u"&#x000013;", u"\r");
+		key = replace_all(key, u"&#x000010;", u"\n");
+		key = replace_all(key, u"&#x000091;", u"[");
+		key = replace_all(key, u"&#x000093;", u"]");
+		key = replace_all(key, u"&#x000123;", u"{");
+		key = replace_all(key, u"&#x000125;", u"}");
+		return key;
+	}
+
+	// Random keys of markup characters, whole and partial escape sequences, letters and non-ASCII characters.
+	void test_escape_key()
+	{
+		const std::u16string_view pieces[] = {
+			u"\r", u"\n", u"[", u"]", u"{", u"}", u"&", u"&#x000091", u"&#x00012", u"&#x", u"#x000093;", u";",
+			u"&#x000013;", u"&#x000010;", u"&#x000091;", u"&#x000093;", u"&#x000123;", u"&#x000125;",
+			u"Key", u"_", u"0", u"\u0416", u"\u00E9",
+		};
+		auto random = std::mt19937{ 25 };
+		std::u16string escaped, unescaped, round_trip;
+		for (size_t n = 0; n < 20000; ++n)
+		{
+			std::u16string key;
+			for (auto count = random() % 10; 0 < count; --count)
+				key += pieces[random() % std::size(pieces)];
+			const auto what = L" of random key " + std::to_wstring(n);
+			check(escape_key(key, escaped) == reference_escape_key(key), L"escape_key" + what);
+			check(unescape_key(key, unescaped) == reference_unescape_key(key), L"unescape_key" + what);
+			// '&' is not escaped, so only keys without whole sequences in them come back unchanged, the others come
+			// back with the sequences replaced by their characters
+			const auto escaped_key = std::u16string{ escape_key(key, escaped) };
+			const auto has_sequence = std::any_of(KEY_ESCAPES.begin(), KEY_ESCAPES.end(), [&] (auto const& escape) {
+				return key.find(escape.second) != std::u16string::npos;
+			});
+			check(unescape_key(escaped_key, round_trip) == (has_sequence ? reference_unescape_key(key) : key), L"unescape_key(escape_key())" + what);
+		}
+		check(unescape_key(escape_key(u"[[Key]]{}\r\n&#x00", escaped), unescaped) == u"[[Key]]{}\r\n&#x00", L"unescape_key(escape_key()) of markup and a partial sequence");
+	}
+
+	// 20 namespaces of synthetic texts: half of the keys are GUIDs, a quarter of the strings repeat an earlier one and
+	// every eighth character is Cyrillic.
+	locres_vector make_texts(string_pool & pool, text_arena & arena, size_t count)
+	{
+		auto random = std::mt19937{ 18 };
+		auto letter = std::uniform_int_distribution<int>(0, 25);
+		auto length = std::uniform_int_distribution<int>(0, 40);
+		locres_vector lv;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (i % (count / 20) == 0)
+				lv.emplace_back(pool.store(u"Namespace" + std::u16string(1, static_cast<char16_t>(u'A' + lv.size()))), std::vector<FEntry>{});
+
+			auto key = std::u16string();
+			if (i % 2 == 0)
+			{
+				for (const auto c : random_string(random, 32, 'A', 'F'))
+					key += static_cast<char16_t>(c);
+			}
+			else
+			{
+				key = u"Key_" + std::u16string(1, static_cast<char16_t>(u'a' + letter(random)));
+				for (auto n = i; n != 0; n /= 10)
+					key += static_cast<char16_t>(u'0' + n % 10);
+			}
+
+			auto s = std::u16string();
+			if (i % 4 == 3)
+			{
+				s = lv.back().second.empty() ? u"" : lv.back().second[random() % lv.back().second.size()].s;
+			}
+			else
+			{
+				s = u"Item name number ";
+				for (auto n = length(random); 0 < n; --n)
+					s += static_cast<char16_t>(random() % 8 != 0 ? u'a' + letter(random) : 0x430 + letter(random));
+			}
+			lv.back().second.push_back(FEntry{ text_key::from_string(key, pool), crc32::StrCrc32(s), arena.store(s), u"" });
+		}
+		return lv;
+	}
+
+	void bench_locres_writer()
+	{
+		constexpr size_t count = 1000000;
+		string_pool pool;
+		text_arena arena;
+		const auto lv = make_texts(pool, arena, count);
+		const auto file = std::filesystem::temp_directory_path() / "UE4TextExtractorSelfTest.locres";
+		for (uint8_t version = 0; version <= 3; ++version)
+		{
+			const auto time = seconds([&] { write_to_locres_file(version, lv, pool, file); });
+			std::wcout << std::fixed << std::setprecision(2)
+				<< L"Locres writer, version " << static_cast<int>(version) << L", " << count << L" texts: " << static_cast<double>(count) / time / 1000000 << L"M texts/s, "
+				<< megabytes_per_second(std::filesystem::file_size(file), time) << L" MB/s" << std::endl;
+			std::wcout.unsetf(std::ios::floatfield);
+		}
+		std::filesystem::remove(file);
+	}
+
+	// The locres to txt conversion of main(): streamed from the reader into a txt_writer.
+	void bench_locres_to_txt()
+	{
+		constexpr size_t count = 1000000;
+		const auto locres_file = std::filesystem::temp_directory_path() / "UE4TextExtractorSelfTest.locres";
+		const auto txt_file = std::filesystem::temp_directory_path() / "UE4TextExtractorSelfTest.txt";
+		for (uint8_t version = 0; version <= 3; ++version)
+		{
+			{
+				string_pool pool;
+				text_arena arena;
+				write_to_locres_file(version, make_texts(pool, arena, count), pool, locres_file);
+			}
+			const auto time = seconds([&] {
+				locres_reader reader;
+				if (!reader.open(locres_file))
+					return;
+				txt_writer writer(txt_file);
+				reader.for_each(
+					[&] (std::u16string_view ns, uint32_t) {
+						writer.write_namespace(ns);
+					},
+					[&] (std::u16string_view key, uint32_t hash, std::u16string_view s) {
+						writer.write_entry(key, hash, s);
+					}
+				);
+				writer.write_end();
+			});
+			std::wcout << std::fixed << std::setprecision(2)
+				<< L"Locres to txt, version " << static_cast<int>(version) << L", " << count << L" texts: " << static_cast<double>(count) / time / 1000000 << L"M texts/s, "
+				<< megabytes_per_second(std::filesystem::file_size(locres_file), time) << L" MB/s of locres" << std::endl;
+			std::wcout.unsetf(std::ios::floatfield);
+		}
+		std::filesystem::remove(locres_file);
+		std::filesystem::remove(txt_file);
+	}
+
+	void bench_txt_parser()
+	{
+		constexpr size_t count = 1000000;
+		const auto file = std::filesystem::temp_directory_path() / "UE4TextExtractorSelfTest.txt";
+		{
+			string_pool pool;
+			text_arena arena;
+			write_to_txt_file(make_texts(pool, arena, count), pool, file, false);
+		}
+		string_pool pool;
+		text_arena arena;
+		size_t parsed = 0;
+		const auto time = seconds([&] {
+			for (auto const& ns : read_txt_file(pool, arena, file))
+				parsed += ns.second.size();
+		});
+		check(parsed == count, L"read_txt_file reads back every text written by write_to_txt_file");
+		std::wcout << std::fixed << std::setprecision(2)
+			<< L"Txt parser, " << count << L" texts: " << static_cast<double>(count) / time / 1000000 << L"M texts/s, "
+			<< megabytes_per_second(std::filesystem::file_size(file), time) << L" MB/s" << std::endl;
+		std::wcout.unsetf(std::ios::floatfield);
+		std::filesystem::remove(file);
+	}
+
+	struct entry
+	{
+		std::wstring_view name;
+		void (*run)();
+	};
+
+	const entry TESTS[] = {
+		{ L"signature_matcher", test_signature_matcher },
+		{ L"package_summary", test_package_summary },
+		{ L"str_crc32", test_str_crc32 },
+		{ L"city_hash", test_city_hash },
+		{ L"ansi_strings", test_ansi_strings },
+		{ L"parse_count", test_parse_count },
+		{ L"chunked_scan", test_chunked_scan },
+		{ L"parallel_directory_extract", test_parallel_directory_extract },
+		{ L"printable_ascii_run", test_printable_ascii_run },
+		{ L"append_utf8", test_append_utf8 },
+		{ L"escape_key", test_escape_key },
+	};
+
+	const entry BENCHMARKS[] = {
+		{ L"signature_matcher", bench_signature_matcher },
+		{ L"locres_writer", bench_locres_writer },
+		{ L"locres_to_txt", bench_locres_to_txt },
+		{ L"txt_parser", bench_txt_parser },
+	};
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t ** argv)
+#else
+int main(int argc, char ** argv)
+#endif
+{
+	for (auto const& test : selftest::TESTS)
+	{
+		const auto failures = selftest::failures;
+		test.run();
+		std::wcout << (failures == selftest::failures ? L"ok      " : L"FAILED  ") << test.name << std::endl;
+	}
+	if (0 < selftest::failures)
+		return 1;
+
+	if (argc == 2 && std::filesystem::path(argv[1]).wstring() == L"-bench")
+		for (auto const& benchmark : selftest::BENCHMARKS)
+			benchmark.run();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+// Generates the BMP range tables GOOD_CHAR_RANGES, WHITE_SPACE_RANGES and LETTER_RANGES of main.cpp with ICU.
+// The tables are cut at Unicode 13.0, the version of the ICU 69 the extractor used to link: code points assigned in
+// later versions are left out, so any ICU from 69 on generates the same tables.
+//
+// gen_bmp_tables          prints the tables to paste into main.cpp
+// gen_bmp_tables -check   compares the tables compiled into main.cpp with ICU, returns 1 on a difference
+//
+// Linux: g++ -std=c++20 tools/gen_bmp_tables.cpp -licuuc -o gen_bmp_tables
+#include <unicode/uchar.h>
+
+#define UE4TEXTEXTRACTOR_NO_MAIN
+#include "../main.cpp"
+
+#include <cstdio>
+
+constexpr uint8_t UNICODE_MAJOR = 13;
+constexpr uint8_t UNICODE_MINOR = 0;
+
+bool assigned_in_unicode_version(UChar32 ch)
+{
+	UVersionInfo age;
+	u_charAge(ch, age);
+	return age[0] < UNICODE_MAJOR || age[0] == UNICODE_MAJOR && age[1] <= UNICODE_MINOR;
+}
+
+// The old good_ch: all categories but controls + format controls and surrogate controls, plus the ISO controls
+// 0x09-0x0d and 0x1c-0x1f.
+bool icu_good_ch(UChar32 ch)
+{
+	if (!assigned_in_unicode_version(ch))
+		return false;
+	if (U_MASK(u_charType(ch)) & (~U_GC_C_MASK | U_GC_CF_MASK | U_GC_CS_MASK))
+		return true;
+	return 0x09 <= ch && ch <= 0x0d || 0x1c <= ch && ch <= 0x1f;
+}
+
+bool icu_white_space(UChar32 ch)
+{
+	return assigned_in_unicode_version(ch) && u_isspace(ch);
+}
+
+bool icu_letter(UChar32 ch)
+{
+	return assigned_in_unicode_version(ch) && u_isalpha(ch);
+}
+
+struct table
+{
+	const char * name;
+	bool (*icu)(UChar32);
+	bmp_property_set const& compiled;
+};
+
+const table TABLES[] = {
+	{ "GOOD_CHAR_RANGES", icu_good_ch, GOOD_CHARS },
+	{ "WHITE_SPACE_RANGES", icu_white_space, WHITE_SPACES },
+	{ "LETTER_RANGES", icu_letter, LETTERS },
+};
+
+void print_table(table const& t)
+{
+	std::vector<code_point_range> ranges;
+	for (UChar32 ch = 0; ch <= 0xFFFF; ++ch)
+	{
+		if (!t.icu(ch))
+			continue;
+		if (!ranges.empty() && ranges.back().last + 1 == ch)
+			ranges.back().last = static_cast<uint16_t>(ch);
+		else
+			ranges.push_back({ static_cast<uint16_t>(ch), static_cast<uint16_t>(ch) });
+	}
+
+	std::printf("constexpr code_point_range %s[] = {\n", t.name);
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		if (i % 8 == 0)
+			std::printf("\t");
+		std::printf("{ 0x%04X, 0x%04X },", ranges[i].first, ranges[i].last);
+		std::printf(i % 8 == 7 || i + 1 == ranges.size() ? "\n" : " ");
+	}
+	std::printf("};\n");
+}
+
+size_t check_table(table const& t)
+{
+	size_t differences = 0;
+	for (UChar32 ch = 0; ch <= 0xFFFF; ++ch)
+	{
+		if (t.icu(ch) == t.compiled.contains(static_cast<uint16_t>(ch)))
+			continue;
+		std::printf("%s differs from ICU at U+%04X\n", t.name, ch);
+		++differences;
+	}
+	return differences;
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc == 2 && std::string_view(argv[1]) == "-check")
+	{
+		size_t differences = 0;
+		for (auto const& t : TABLES)
+			differences += check_table(t);
+		std::printf("ICU %s (Unicode %s): %zu differences\n", U_ICU_VERSION, U_UNICODE_VERSION, differences);
+		return differences == 0 ? 0 : 1;
+	}
+
+	for (auto const& t : TABLES)
+		print_table(t);
+	return 0;
+}
\ No newline at end of file